@@ -73,27 +73,21 @@ uint64_t polyglotCombined[14][64];
 int num_threads = 1;
 int move_overhead = 100;
 
-SearchThread search_threads[MAX_THREADS];
+SearchThread *search_threads[MAX_THREADS];
 
 int mvvlva_values[12][14];
 
 int reductions[2][64][64];
 
-PV pv[MAX_PLY + 1];
 PV debug_pv;
 
 void get_ready() {
-    // Clear pv
-    for (int i = 0; i < MAX_PLY; i++) {
-        pv[i].size = 0;
-    }
-
-    SearchThread *main_thread = &search_threads[0];
+    SearchThread *main_thread = search_threads[0];
     main_thread->root_ply = main_thread->search_ply;
 
     // Copy over the root position
-    for (int i = 1; i < MAX_THREADS; ++i) {
-        SearchThread *t = &(search_threads[i]);
+    for (int i = 1; i < num_threads; ++i) {
+        SearchThread *t = search_threads[i];
         t->root_ply = t->search_ply = main_thread->root_ply;
 
         // Need to fully copy the position
@@ -102,10 +96,15 @@ void get_ready() {
         p->my_thread = t;
     }
 
-    for (int i = 0; i < MAX_THREADS; ++i) {
-        SearchThread *t = &(search_threads[i]);
+    for (int i = 0; i < num_threads; ++i) {
+        SearchThread *t = search_threads[i];
         t->depth = 1;
 
+        // Clear pv
+        for (int j = 0; j < MAX_PLY + 1; ++j) {
+            t->pv[j].size = 0;
+        }
+
         // Clear the metadata
         for (int j = 0; j < MAX_PLY + 1; ++j) {
             Metadata *md = &t->metadatas[j];
@@ -619,15 +618,19 @@ void init_lmr() {
     }
 }
 
-void init_threads() {
-    for (int i = 0; i < MAX_THREADS; ++i) {
-        SearchThread *search_thread = &search_threads[i];
-        std::memset(search_thread->positions, 0, sizeof(search_thread->positions));
-        search_thread->thread_id = i;
-        search_thread->search_ply = 0;
-        search_thread->root_ply = 0;
-        search_thread->depth = 1;
-    }
+SearchThread *new_search_thread(int thread_id) {
+    // Value initialization zeroes the whole state, so the pages are first
+    // touched by the calling thread and end up on its NUMA node
+    SearchThread *search_thread = new SearchThread();
+    search_thread->thread_id = thread_id;
+    search_thread->depth = 1;
+    return search_thread;
+}
+
+void free_search_thread(SearchThread *search_thread) {
+    free(search_thread->pawntt);
+    free(search_thread->eval_cache);
+    delete search_thread;
 }
 
 void init_masks() {
@@ -655,10 +658,8 @@ void init_masks() {
 
 void init() {
     init_masks();
-    init_tt();
     init_magic();
     init_eval();
     init_imbalance();
     generate_bitbase();
-    init_threads();
 }
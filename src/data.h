@@ -25,6 +25,7 @@
 #include <cstdlib>
 #include <algorithm>
 #include <thread>
+#include <vector>
 #include "params.h"
 #include <atomic>
 
@@ -153,7 +154,14 @@ typedef struct PV {
     int  size;
 } PV;
 
-extern PV pv[MAX_PLY + 1];
+typedef struct RootMove {
+    Move move;
+    int  score;          // Of the last depth this move's line was searched at
+    int  previous_score; // Of the depth before, for the aspiration window
+    int  depth;
+    uint64_t nodes;      // Searched below this move in the current iteration
+    PV   pv;             // Of the depth in depth
+} RootMove;
 extern PV debug_pv;
 
 void get_ready();
@@ -277,6 +285,7 @@ const int position_size = sizeof(CopyThingSize);
 typedef struct Metadata {
     int  ply;
     Move current_move;
+    Piece moved_piece; // Of current_move, for the continuation histories
     int  static_eval;
     Move killers[2];
     Move excluded_move;
@@ -303,6 +312,9 @@ struct Position {
     Color    color;
 };
 
+struct PawnTTEntry;
+struct EvalCacheEntry;
+
 typedef struct Evaluation {
     // Position *position;
     Bitboard targets[14];
@@ -321,9 +333,10 @@ typedef struct Evaluation {
     Score    mobility_score[2];
     Bitboard pawn_passers[2];
     Square   bishop_squares[2];
+    const PawnTTEntry *pawntte;
 } Evaluation;
 
-const Evaluation init_evaluation = Evaluation{{}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}};
+const Evaluation init_evaluation = Evaluation{{}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}};
 
 enum EndgameType {
     NORMAL_ENDGAME,
@@ -368,7 +381,8 @@ inline Material *get_material(Position *p) { return &material_base[p->material_i
 enum SearchType {
     NORMAL_SEARCH = 0,
     QUIESCENCE_SEARCH = 1,
-    PERFT_SEARCH = 2
+    PERFT_SEARCH = 2,
+    LEGAL_SEARCH = 3 // Staged like NORMAL_SEARCH but only yields legal moves
 };
 
 typedef struct ScoredMove {
@@ -416,6 +430,9 @@ enum ScoreType {
     SCORE_EVASION = 2
 };
 
+// Histories of the moves that followed a given piece and to square
+typedef int16_t PieceToHistory[14][64];
+
 struct MoveGen {
     ScoredMove moves[256];
     Position   *position;
@@ -427,6 +444,9 @@ struct MoveGen {
     uint8_t    tail;
     int        end_bad_captures;
     int        depth;
+    PieceToHistory *counter_history;  // Of the previous move, nullptr if there is none
+    PieceToHistory *followup_history; // Of the move two plies back
+    bool       legal;                 // Generate legal moves only, no is_legal needed
 };
 
 const MoveGen blank_movegen = {
@@ -439,42 +459,95 @@ const MoveGen blank_movegen = {
     0, // head
     0, // tail
     0, // end bad captures
-    0 // ply
+    0, // ply
+    nullptr, // counter history
+    nullptr, // follow-up history
+    false // legal
 };
 
+// What set_tte did with the slot it was given
+enum TTStoreType {
+    STORE_EMPTY,         // slot was empty
+    STORE_UPDATE,        // same position, entry rewritten
+    STORE_MOVE_ONLY,     // same position, deeper entry kept, at most the move changed
+    STORE_REPLACE_AGE,   // other position from an older search evicted
+    STORE_REPLACE_DEPTH, // other position from this search evicted
+    STORE_TYPES
+};
+
+typedef struct TTStats {
+    uint64_t probes;
+    uint64_t hits;
+    uint64_t collisions; // hits whose move was not pseudolegal, i.e. a 16 bit key clash
+    uint64_t cutoffs[3]; // indexed by FLAG_EXACT, FLAG_BETA, FLAG_ALPHA
+    uint64_t stores[STORE_TYPES];
+} TTStats;
+
+// Hash statistics are only counted in builds with -D__TTSTATS__ (make ttstats)
+#ifdef __TTSTATS__
+#define TT_STAT(thread, counter) (++(thread)->tt_stats.counter)
+#else
+#define TT_STAT(thread, counter) ((void) (thread))
+#endif
+
 struct SearchThread {
-    std::thread thread_obj;
     Position    positions[1024];
     int         thread_id;
     int         root_ply;
     int         search_ply;
     Metadata    metadatas[MAX_PLY + 1];
+    PV          pv[MAX_PLY + 1]; // Triangular PV table, pv[0] is the line from the root
     Move        counter_moves[14][64];
     int         history[14][64];
+    PieceToHistory counter_history[14][64];  // By the previous move's piece and to square
+    PieceToHistory followup_history[14][64]; // By the piece and to square of the move two plies back
+    int16_t     capture_history[14][64][7];  // By piece, to square and captured piece type
+    PawnTTEntry *pawntt;
+    uint64_t    pawntt_mask;
+    EvalCacheEntry *eval_cache;
+    uint64_t    eval_cache_mask;
+    uint64_t    eval_probes;
+    uint64_t    eval_hits;
+    bool        searching; // Guarded by the pool mutex in search.cpp
+    std::vector<RootMove> root_moves; // Filled for every thread by think
+    int         pv_index;       // MultiPV line being searched
+    Move        best_move;      // Of the last completed iteration
+    int         best_score;
+    int         completed_depth;
     std::atomic<int>      depth;
     std::atomic<uint64_t> nodes;
     std::atomic<uint64_t> tb_hits;
+    TTStats               tt_stats;
 };
 
 inline bool is_main_thread(Position *p) {return p->my_thread->thread_id == 0;}
 
 const int MAX_THREADS = 64;
-extern SearchThread search_threads[MAX_THREADS];
+// Allocated by each worker of the search pool for itself, see init_pool
+extern SearchThread *search_threads[MAX_THREADS];
+
+SearchThread *new_search_thread(int thread_id);
+void free_search_thread(SearchThread *search_thread);
 
 extern int num_threads;
 extern int move_overhead;
 
 inline void initialize_threads() {
     for (int i = 0; i < num_threads; ++i) {
-        search_threads[i].nodes = 0;
-        search_threads[i].tb_hits = 0;
+        search_threads[i]->nodes = 0;
+        search_threads[i]->tb_hits = 0;
+        search_threads[i]->tt_stats = TTStats{};
+        search_threads[i]->eval_probes = 0;
+        search_threads[i]->eval_hits = 0;
+        search_threads[i]->best_move = no_move;
+        search_threads[i]->completed_depth = 0;
     }
 }
 
 inline uint64_t sum_nodes() {
     uint64_t s = 0;
     for (int i = 0; i < num_threads; ++i) {
-        s += search_threads[i].nodes.load(std::memory_order_relaxed);
+        s += search_threads[i]->nodes.load(std::memory_order_relaxed);
     }
     return s;
 }
@@ -482,7 +555,25 @@ inline uint64_t sum_nodes() {
 inline uint64_t sum_tb_hits() {
     uint64_t s = 0;
     for (int i = 0; i < num_threads; ++i) {
-        s += search_threads[i].tb_hits.load(std::memory_order_relaxed);
+        s += search_threads[i]->tb_hits.load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+// Only safe while no search is running
+inline TTStats sum_tt_stats() {
+    TTStats s = {};
+    for (int i = 0; i < num_threads; ++i) {
+        TTStats *t = &search_threads[i]->tt_stats;
+        s.probes += t->probes;
+        s.hits += t->hits;
+        s.collisions += t->collisions;
+        for (int j = 0; j < 3; ++j) {
+            s.cutoffs[j] += t->cutoffs[j];
+        }
+        for (int j = 0; j < STORE_TYPES; ++j) {
+            s.stores[j] += t->stores[j];
+        }
     }
     return s;
 }
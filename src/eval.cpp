@@ -118,9 +118,33 @@ void evaluate_pawn_init(Evaluation *eval, Position *p, Color color) {
     }
 }
 
+int evaluate_pawn_shelter(Position *p, Color color, Square index) {
+    int pawn_shelter_value = 150;
+    int middle = std::max(FILE_B, std::min(FILE_G, col(index)));
+
+    int king_rank = rank(index, color);
+    pawn_shelter_value -= (king_rank - RANK_1) * pawn_shelter_penalty[3]; // Take a look at this again sometime
+
+    for (int column = middle - 1; column <= middle + 1; column++) {
+        Bitboard pawns = p->bbs[pawn(color)] & FILE_MASK[column];
+        if (pawns) {
+            Square closest_pawn = color == white ? lsb(pawns) : msb(pawns);
+            int pawn_rank = rank(closest_pawn, color);
+            if (king_rank <= pawn_rank) {
+                pawn_shelter_value -= pawn_shelter_penalty[pawn_rank - king_rank];
+            }
+        } else {
+            pawn_shelter_value -= pawn_shelter_penalty[7];
+        }
+    }
+
+    return pawn_shelter_value;
+}
+
 void evaluate_pawns(Evaluation *eval, Position *p) {
-    PawnTTEntry *pawntte = get_pawntte(p->pawn_hash);
+    PawnTTEntry *pawntte = get_pawntte(p);
     if (pawntte) {
+        eval->pawntte = pawntte;
         evaluate_pawn_init(eval, p, white);
         evaluate_pawn_init(eval, p, black);
         eval->score_pawn = pawntte->score;
@@ -135,7 +159,12 @@ void evaluate_pawns(Evaluation *eval, Position *p) {
     Score blacky = evaluate_pawn_structure(eval, p, black);
     eval->score_pawn = whitey - blacky;
 
-    set_pawntte(p->pawn_hash, eval);
+    pawntte = set_pawntte(p, eval);
+    for (int file = FILE_A; file <= FILE_H; ++file) {
+        pawntte->king_shelter[white][file] = evaluate_pawn_shelter(p, white, relative_square(Square(file), white));
+        pawntte->king_shelter[black][file] = evaluate_pawn_shelter(p, black, relative_square(Square(file), black));
+    }
+    eval->pawntte = pawntte;
 }
 
 Score evaluate_bishop(Evaluation *eval, Position *p, Color color) {
@@ -309,27 +338,8 @@ Score evaluate_queen(Evaluation *eval, Position *p, Color color) {
     return queen_score;
 }
 
-int evaluate_pawn_shelter(Position *p, Color color, Square index) {
-    int pawn_shelter_value = 150;
-    int middle = std::max(FILE_B, std::min(FILE_G, col(index)));
-
-    int king_rank = rank(index, color);
-    pawn_shelter_value -= (king_rank - RANK_1) * pawn_shelter_penalty[3]; // Take a look at this again sometime
-
-    for (int column = middle - 1; column <= middle + 1; column++) {
-        Bitboard pawns = p->bbs[pawn(color)] & FILE_MASK[column];
-        if (pawns) {
-            Square closest_pawn = color == white ? lsb(pawns) : msb(pawns);
-            int pawn_rank = rank(closest_pawn, color);
-            if (king_rank <= pawn_rank) {
-                pawn_shelter_value -= pawn_shelter_penalty[pawn_rank - king_rank];
-            }
-        } else {
-            pawn_shelter_value -= pawn_shelter_penalty[7];
-        }
-    }
-
-    return pawn_shelter_value;
+inline int king_shelter(Evaluation *eval, Position *p, Color color, Square index) {
+    return rank(index, color) == RANK_1 ? eval->pawntte->king_shelter[color][col(index)] : evaluate_pawn_shelter(p, color, index);
 }
 
 Score evaluate_king(Evaluation *eval, Position *p, Color color) {
@@ -338,12 +348,12 @@ Score evaluate_king(Evaluation *eval, Position *p, Color color) {
     Square outpost = p->king_index[color];
     Bitboard king_targets = generate_king_targets(outpost);
 
-    int pawn_shelter_value = evaluate_pawn_shelter(p, color, outpost);
+    int pawn_shelter_value = king_shelter(eval, p, color, outpost);
     if (p->castling & can_king_castle_mask[color]) {
-        pawn_shelter_value = std::max(pawn_shelter_value, evaluate_pawn_shelter(p, color, relative_square(G1, color)));
+        pawn_shelter_value = std::max(pawn_shelter_value, int(eval->pawntte->king_shelter[color][FILE_G]));
     }
     if (p->castling & can_queen_castle_mask[color]) {
-        pawn_shelter_value = std::max(pawn_shelter_value, evaluate_pawn_shelter(p, color, relative_square(C1, color)));
+        pawn_shelter_value = std::max(pawn_shelter_value, int(eval->pawntte->king_shelter[color][FILE_C]));
     }
     king_score.midgame += pawn_shelter_value;
 
@@ -636,9 +646,7 @@ int scaling_factor(Evaluation *eval, Position *p, Material *eval_material) {
     return SCALE_NORMAL;
 }
 
-int evaluate(Position *p) {
-    assert(!is_checked(p));
-
+int full_evaluate(Position *p) {
     Evaluation eval = init_evaluation;
     pre_eval(&eval, p);
 
@@ -677,6 +685,30 @@ int evaluate(Position *p) {
     return (p->color == white ? ret : -ret) + tempo;
 }
 
+int evaluate(Position *p) {
+    assert(!is_checked(p));
+
+#ifdef __TUNE__
+    return full_evaluate(p);
+#else
+    // The static eval also lives in the tt, this catches the nodes whose entry
+    // was replaced or never stored, quiescence in particular
+    SearchThread *t = p->my_thread;
+    EvalCacheEntry *entry = get_eval_cache(p);
+    uint32_t key = (uint32_t)(p->hash >> 32);
+    ++t->eval_probes;
+    if (entry->key == key) {
+        ++t->eval_hits;
+        return entry->eval;
+    }
+
+    int eval = full_evaluate(p);
+    entry->key = key;
+    entry->eval = eval;
+    return eval;
+#endif
+}
+
 void print_eval(Position *p){
     Evaluation eval = init_evaluation;
     pre_eval(&eval, p);
@@ -18,12 +18,28 @@
 
 #include "magic.h"
 
+#ifdef __PEXT__
+Bitboard rook_pext_moves[ROOK_PEXT_SIZE];
+Bitboard bishop_pext_moves[BISHOP_PEXT_SIZE];
+Bitboard *rook_pext_slices[64];
+Bitboard *bishop_pext_slices[64];
+#else
 Bitboard rook_magic_moves[64][4096];
 Bitboard bishop_magic_moves[64][512];
+#endif
 
 void init_magic(){
+#ifdef __PEXT__
+    Bitboard *rook_end = generate_pext_moves(rook_pext_moves, rook_pext_slices, rookMagic, create_rook_attacks);
+    Bitboard *bishop_end = generate_pext_moves(bishop_pext_moves, bishop_pext_slices, bishopMagic, create_bishop_attacks);
+    assert(rook_end == rook_pext_moves + ROOK_PEXT_SIZE);
+    assert(bishop_end == bishop_pext_moves + BISHOP_PEXT_SIZE);
+    (void)rook_end;
+    (void)bishop_end;
+#else
     generate_magic_rook_moves();
     generate_magic_bishop_moves();
+#endif
 }
 
 Bitboard magicify(uint64_t square, Bitboard b) {
@@ -64,6 +80,20 @@ Bitboard create_bishop_attacks(int sq, Bitboard b) {
     return vertical_attacks | line_attacks;
 }
 
+#ifdef __PEXT__
+Bitboard *generate_pext_moves(Bitboard *table, Bitboard **slices, const Magic *magics, Bitboard (*create_attacks)(int, Bitboard)) {
+    for (int sq = A1; sq <= H8; ++sq) {
+        Bitboard mask = magics[sq].mask;
+        slices[sq] = table;
+        // magicify(i, mask) is the occupancy whose pext over mask is i
+        for (uint64_t i = 0; i < bfi[count(mask)]; ++i) {
+            table[i] = create_attacks(sq, magicify(i, mask));
+        }
+        table += bfi[count(mask)];
+    }
+    return table;
+}
+#else
 void generate_magic_rook_moves() {
     for (int sq = A1; sq <= H8; ++sq){
         Bitboard mask = trim(ROOK_MASKS_COMBINED[sq] ^ bfi[sq], row(sq), col(sq));
@@ -85,3 +115,4 @@ void generate_magic_bishop_moves() {
         }
     }
 }
+#endif
@@ -22,6 +22,10 @@
 #include "data.h"
 #include "bitboard.h"
 
+#ifdef __PEXT__
+#include <immintrin.h>
+#endif
+
 typedef struct Magic{
     Bitboard mask;
     Bitboard magic;
@@ -97,8 +101,12 @@ const Magic bishopMagic[64] = {
     { 0x0020100804020000ULL, 0x0000005002301100ULL }, { 0x0040201008040200ULL, 0x0080881014040040ULL }
 };
 
+#ifdef __PEXT__
+Bitboard *generate_pext_moves(Bitboard *table, Bitboard **slices, const Magic *magics, Bitboard (*create_attacks)(int, Bitboard));
+#else
 void generate_magic_rook_moves();
 void generate_magic_bishop_moves();
+#endif
 
 Bitboard magicify(int index, Bitboard b);
 
@@ -107,7 +115,27 @@ Bitboard create_bishop_attacks(int sq ,Bitboard b);
 
 void init_magic();
 
+#ifdef __PEXT__
+// One slice of 2^count(mask) entries per square, indexed by pext(board, mask)
+const int ROOK_PEXT_SIZE = 102400;
+const int BISHOP_PEXT_SIZE = 5248;
+
+extern Bitboard rook_pext_moves[ROOK_PEXT_SIZE];
+extern Bitboard bishop_pext_moves[BISHOP_PEXT_SIZE];
+extern Bitboard *rook_pext_slices[64];
+extern Bitboard *bishop_pext_slices[64];
+#else
 extern Bitboard rook_magic_moves[64][4096];
 extern Bitboard bishop_magic_moves[64][512];
+#endif
+
+// Bytes taken by the sliding attack tables
+inline size_t slider_table_size() {
+#ifdef __PEXT__
+    return sizeof(rook_pext_moves) + sizeof(bishop_pext_moves);
+#else
+    return sizeof(rook_magic_moves) + sizeof(bishop_magic_moves);
+#endif
+}
 
 #endif
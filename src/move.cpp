@@ -21,6 +21,7 @@
 #include "move.h"
 #include "target.h"
 #include "movegen.h"
+#include "tt.h"
 #include <cstring>
 
 void move_piece(Position *p, Square from, Square to, Piece piece, Color curr_c) {
@@ -55,17 +56,17 @@ void capture(Position *p, Square to, Piece captured, Color opponent) {
     p->score -= pst[captured][to];
 }
 
-void capture_enpassant(Position *p, Square to, Square enpassant_to, Piece captured, Color opponent) {
+void capture_enpassant(Position *p, Square enpassant_to, Piece captured, Color opponent) {
     p->bbs[captured] ^= bfi[enpassant_to];
     p->bbs[opponent] ^= bfi[enpassant_to];
     p->pieces[enpassant_to] = no_piece;
     p->board ^= bfi[enpassant_to];
 
-    uint64_t h = polyglotCombined[captured][to];
+    uint64_t h = polyglotCombined[captured][enpassant_to];
     p->hash ^= h;
     p->pawn_hash ^= h;
     p->material_index -= material_balance[captured];
-    p->score -= pst[captured][to];
+    p->score -= pst[captured][enpassant_to];
 }
 
 void promote(Position *p, Square to, Piece pawn, Piece promotion_type, Color color) {
@@ -121,7 +122,7 @@ Position *make_move(Position *p, Move move) {
             assert(p->pieces[to] == no_piece);
             assert(p->pieces[enpassant_to] == pawn(opponent));
 
-            capture_enpassant(new_p, to, enpassant_to, captured, opponent);
+            capture_enpassant(new_p, enpassant_to, captured, opponent);
         } else {
             capture(new_p, to, captured, opponent);
         }
@@ -147,10 +148,16 @@ Position *make_move(Position *p, Move move) {
         }
     }
 
-    if (new_p->castling && CASTLING_RIGHTS[from] & CASTLING_RIGHTS[to]) {
-        int castling_rights = CASTLING_RIGHTS[from] & CASTLING_RIGHTS[to];
-        new_p->castling &= castling_rights;
-        new_p->hash ^= castlingHash[castling_rights];
+    if (new_p->castling) {
+        // Only the rights that were actually lost change the hash
+        int castling_rights = new_p->castling & CASTLING_RIGHTS[from] & CASTLING_RIGHTS[to];
+        new_p->hash ^= castlingHash[new_p->castling ^ castling_rights];
+        new_p->castling = castling_rights;
+    }
+
+    prefetch_tt(new_p->hash);
+    if (new_p->pawn_hash != p->pawn_hash) {
+        prefetch_pawntt(new_p);
     }
 
     new_p->pinned[white] = pinned_piece_squares(new_p, white);
@@ -175,6 +182,8 @@ Position *make_null_move(Position *p) {
         new_p->hash ^= polyglotEnpassant[col(p->enpassant)];
     }
 
+    prefetch_tt(new_p->hash);
+
     new_p->pinned[white] = pinned_piece_squares(new_p, white);
     new_p->pinned[black] = pinned_piece_squares(new_p, black);
 
@@ -56,13 +56,19 @@ inline bool is_checked_color(Position *p, Color color) {
     return targeted_from(p, p->board, color, p->king_index[color]);
 }
 
+// En passant takes two pawns off the board at once, which the pins do not
+// cover. Look for attackers of the king on the board after the capture.
+inline bool is_legal_enpassant(Position *p, Move m) {
+    Square from = move_from(m);
+    Square to = move_to(m);
+    Bitboard board = (p->board ^ bfi[from] ^ bfi[ENPASSANT_INDEX[to]]) | bfi[to];
+    // The captured pawn is still in its bitboard, the board mask drops it
+    return !(targeted_from(p, board, p->color, p->king_index[p->color]) & board);
+}
+
 inline bool is_legal(Position *p, Move m) {
     if (move_type(m) == ENPASSANT) {
-        Position *new_p = make_move(p, m);
-        // Check if the side that made the move is in check
-        bool checked = is_checked_color(new_p, p->color);
-        undo_move(new_p);
-        return !checked;
+        return is_legal_enpassant(p, m);
     }
 
     Square to = move_to(m);
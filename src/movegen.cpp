@@ -38,18 +38,18 @@ void print_movegen(MoveGen *movegen) {
 void score_moves(MoveGen *movegen, ScoreType score_type) {
     if (score_type == SCORE_CAPTURE) {
         for (uint8_t i = movegen->head; i < movegen->tail; ++i) {
-            movegen->moves[i].score = score_capture_mvvlva(movegen->position, movegen->moves[i].move);
+            movegen->moves[i].score = score_capture(movegen->position, movegen->moves[i].move);
         }
     } else if (score_type == SCORE_QUIET) {
         for (uint8_t i = movegen->head; i < movegen->tail; ++i) {
-            movegen->moves[i].score = score_quiet(movegen->position, movegen->moves[i].move);
+            movegen->moves[i].score = score_quiet(movegen, movegen->moves[i].move);
         }
     } else { // Evasions
         for (uint8_t i = movegen->head; i < movegen->tail; ++i) {
             if (is_capture(movegen->position, movegen->moves[i].move)) {
-                movegen->moves[i].score = score_capture_mvvlva(movegen->position, movegen->moves[i].move);
+                movegen->moves[i].score = score_capture(movegen->position, movegen->moves[i].move);
             } else {
-                movegen->moves[i].score = score_quiet(movegen->position, movegen->moves[i].move) - (1 << 30);
+                movegen->moves[i].score = score_quiet(movegen, movegen->moves[i].move) - (1 << 30);
             }
         }
     }
@@ -102,7 +102,8 @@ Move next_move(MoveGen *movegen) {
             if (move &&
                 move != movegen->tte_move &&
                 is_pseudolegal(movegen->position, move) &&
-                !is_capture(movegen->position, move)) {
+                !is_capture(movegen->position, move) &&
+                (!movegen->legal || is_legal(movegen->position, move))) {
                 return move;
             }
             /* fallthrough */
@@ -113,7 +114,8 @@ Move next_move(MoveGen *movegen) {
             if (move &&
                 move != movegen->tte_move &&
                 is_pseudolegal(movegen->position, move) &&
-                !is_capture(movegen->position, move)) {
+                !is_capture(movegen->position, move) &&
+                (!movegen->legal || is_legal(movegen->position, move))) {
                 return move;
             }
             /* fallthrough */
@@ -126,7 +128,8 @@ Move next_move(MoveGen *movegen) {
                 move != movegen->killer_moves[0] &&
                 move != movegen->killer_moves[1] &&
                 is_pseudolegal(movegen->position, move) &&
-                !is_capture(movegen->position, move)) {
+                !is_capture(movegen->position, move) &&
+                (!movegen->legal || is_legal(movegen->position, move))) {
                 return move;
             }
             /* fallthrough */
@@ -246,6 +249,11 @@ MoveGen new_movegen(Position *p, Metadata *md, int depth, Move tte_move, uint8_t
     int ply = md->ply;
     int movegen_stage;
     Move tm;
+#ifdef __TTSTATS__
+    if (tte_move && !in_check && !is_pseudolegal(p, tte_move)) {
+        TT_STAT(p->my_thread, collisions);
+    }
+#endif
     if (in_check) {
         // tm = tte_move && is_pseudolegal(p, tte_move) ? tte_move : no_move;
         tm = no_move;
@@ -262,8 +270,8 @@ MoveGen new_movegen(Position *p, Metadata *md, int depth, Move tte_move, uint8_t
             } else {
                 movegen_stage = QUIESCENCE_TTE_MOVE;
             }
-        } else {  // Perft
-            tm = tte_move && is_pseudolegal(p, tte_move) ? tte_move : no_move;
+        } else {  // Perft and legal
+            tm = tte_move && is_pseudolegal(p, tte_move) && is_legal(p, tte_move) ? tte_move : no_move;
             movegen_stage = NORMAL_TTE_MOVE;
         }
     }
@@ -283,7 +291,10 @@ MoveGen new_movegen(Position *p, Metadata *md, int depth, Move tte_move, uint8_t
         0, // head
         0, // tail
         0, // end bad captures
-        depth // depth
+        depth, // depth
+        ply > 0 ? continuation_history(my_thread->counter_history, md - 1) : nullptr, // counter history
+        ply > 1 ? continuation_history(my_thread->followup_history, md - 2) : nullptr, // follow-up history
+        type == PERFT_SEARCH || type == LEGAL_SEARCH // legal
     };
     return movegen;
 }
@@ -299,8 +310,11 @@ void generate_evasions(MoveGen *movegen, Position *p) {
         // Capture or  Block attacker
         Square attacker_index = lsb(attackers);
 
+        // A pinned piece can neither capture the checker nor block it
+        Bitboard movable = movegen->legal ? ~p->pinned[p->color] : ~0ULL;
+
         // King captures are already handled in generate_king_evasions
-        Bitboard capture_attackers = targeted_from(p, p->board, opponent_color(p->color), attacker_index);
+        Bitboard capture_attackers = targeted_from(p, p->board, opponent_color(p->color), attacker_index) & movable;
         while (capture_attackers) {
             Square index = pop(&capture_attackers);
             if (is_pawn(p->pieces[index])) {
@@ -326,7 +340,9 @@ void generate_evasions(MoveGen *movegen, Position *p) {
             while (capture_attackers) {
                 Square index = pop(&capture_attackers);
                 Move m = _movecast(index, p->enpassant, ENPASSANT);
-                append_move(m, movegen);
+                if (!movegen->legal || is_legal_enpassant(p, m)) {
+                    append_move(m, movegen);
+                }
             }
         }
 
@@ -334,7 +350,7 @@ void generate_evasions(MoveGen *movegen, Position *p) {
 
         while (between_two) {
             Square blocking_square = pop(&between_two);
-            Bitboard blockers = can_go_to(p, opponent_color(p->color), blocking_square);
+            Bitboard blockers = can_go_to(p, opponent_color(p->color), blocking_square) & movable;
             while (blockers) {
                 Square index = pop(&blockers);
                 if (is_pawn(p->pieces[index]) && rank(index, p->color) == RANK_7) {
@@ -31,9 +31,24 @@ void generate_evasions(MoveGen *movegen, Position *p);
 void generate_king_evasions(MoveGen *movegen, Position *p);
 Move next_move(MoveGen *movegen);
 
-inline int score_quiet(Position *p, Move move) {
+// The slice of table that follows the move made at md, nullptr after a null move
+inline PieceToHistory *continuation_history(PieceToHistory (*table)[64], Metadata *md) {
+    Move move = md->current_move;
+    return move != no_move && move != null_move ? &table[md->moved_piece][move_to(move)] : nullptr;
+}
+
+inline int score_quiet(MoveGen *movegen, Move move) {
+    Position *p = movegen->position;
     Piece piece = p->pieces[move_from(move)];
-    return p->my_thread->history[piece][move_to(move)];
+    Square to = move_to(move);
+    int score = p->my_thread->history[piece][to];
+    if (movegen->counter_history) {
+        score += (*movegen->counter_history)[piece][to];
+    }
+    if (movegen->followup_history) {
+        score += (*movegen->followup_history)[piece][to];
+    }
+    return score;
 }
 
 inline int score_capture_mvvlva(Position *p, Move move) {
@@ -45,20 +60,22 @@ inline int score_capture_mvvlva(Position *p, Move move) {
     return mvvlva_values[to_piece][from_piece];
 }
 
+// The victim still comes first, the capture history only orders captures of a
+// similar victim
+inline int score_capture(Position *p, Move move) {
+    Piece from_piece = p->pieces[move_from(move)];
+    Square to = move_to(move);
+    int history = p->my_thread->capture_history[from_piece][to][piece_type(p->pieces[to])];
+    return score_capture_mvvlva(p, move) * 16 + history / 64;
+}
+
 inline bool no_moves(MoveGen *movegen) {
     return movegen->tail == movegen->head;
 }
 
 inline void append_move(Move m, MoveGen *movegen) {
-#ifdef __PERFT__
-    if (is_legal(movegen->position, m)){
-        movegen->moves[movegen->tail] = ScoredMove{m, UNDEFINED};
-        ++movegen->tail;
-    }
-#else
     movegen->moves[movegen->tail] = ScoredMove{m, UNDEFINED};
     ++movegen->tail;
-#endif
 }
 
 // Should not have to check legality...
@@ -67,6 +84,14 @@ inline void append_evasion(Move m, MoveGen *movegen) {
     ++movegen->tail;
 }
 
+// A pinned piece of a legal generator stays on the line through its king
+inline Bitboard pin_mask(MoveGen *movegen, Position *p, Square from) {
+    if (movegen->legal && on(p->pinned[p->color], from)) {
+        return FROMTO_MASK[from][p->king_index[p->color]];
+    }
+    return ~0ULL;
+}
+
 template<MoveGenType Type> inline Bitboard type_mask(Position *p) {
     if (Type == SILENT) {
         return ~p->board;
@@ -82,6 +107,10 @@ void generate_piece_moves(MoveGen *movegen, Position *p) {
     Bitboard mask = type_mask<Type>(p);
 
     Bitboard bbs = p->bbs[knight(p->color)];
+    if (movegen->legal) {
+        // A pinned knight always leaves the line to its king
+        bbs &= ~p->pinned[p->color];
+    }
     while (bbs) {
         Square outpost = pop(&bbs);
         Bitboard b = generate_knight_targets(outpost) & mask;
@@ -95,7 +124,7 @@ void generate_piece_moves(MoveGen *movegen, Position *p) {
     bbs = p->bbs[bishop(p->color)];
     while (bbs) {
         Square outpost = pop(&bbs);
-        Bitboard b = generate_bishop_targets(p->board, outpost) & mask;
+        Bitboard b = generate_bishop_targets(p->board, outpost) & mask & pin_mask(movegen, p, outpost);
         while (b) {
             Square index = pop(&b);
             Move m = _movecast(outpost, index, NORMAL);
@@ -106,7 +135,7 @@ void generate_piece_moves(MoveGen *movegen, Position *p) {
     bbs = p->bbs[rook(p->color)];
     while (bbs) {
         Square outpost = pop(&bbs);
-        Bitboard b = generate_rook_targets(p->board, outpost) & mask;
+        Bitboard b = generate_rook_targets(p->board, outpost) & mask & pin_mask(movegen, p, outpost);
         while (b) {
             Square index = pop(&b);
             Move m = _movecast(outpost, index, NORMAL);
@@ -117,7 +146,7 @@ void generate_piece_moves(MoveGen *movegen, Position *p) {
     bbs = p->bbs[queen(p->color)];
     while (bbs) {
         Square outpost = pop(&bbs);
-        Bitboard b = generate_queen_targets(p->board, outpost) & mask;
+        Bitboard b = generate_queen_targets(p->board, outpost) & mask & pin_mask(movegen, p, outpost);
         while (b) {
             Square index = pop(&b);
             Move m = _movecast(outpost, index, NORMAL);
@@ -132,7 +161,7 @@ void generate_pawn_moves(MoveGen *movegen, Position *p) {
     Bitboard bbs = p->bbs[pawn(curr_c)];
     while (bbs) {
         Square outpost = pop(&bbs);
-        Bitboard b = generate_pawn_targets<Type>(p, outpost);
+        Bitboard b = generate_pawn_targets<Type>(p, outpost) & pin_mask(movegen, p, outpost);
         while (b) {
             Square index = pop(&b);
             int r = rank(index, curr_c);
@@ -144,7 +173,9 @@ void generate_pawn_moves(MoveGen *movegen, Position *p) {
                 append_move(_promoteq(m), movegen);
             } else if (p->enpassant && index == p->enpassant) {
                 Move m = _movecast(outpost, index, ENPASSANT);
-                append_move(m, movegen);
+                if (!movegen->legal || is_legal_enpassant(p, m)) {
+                    append_move(m, movegen);
+                }
             } else {
                 Move m = _movecast(outpost, index, NORMAL);
                 append_move(m, movegen);
@@ -175,6 +206,9 @@ void generate_king_moves(MoveGen *movegen, Position *p) {
     b = generate_king_targets(outpost) & mask;
     while (b) {
         Square index = pop(&b);
+        if (movegen->legal && targeted_from_with_king(p, p->board, p->color, index)) {
+            continue;
+        }
         Move m = _movecast(outpost, index, NORMAL);
         append_move(m, movegen);
     }
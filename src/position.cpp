@@ -142,7 +142,7 @@ Position* import_fen(std::string fen, int thread_id){
         halfmove_clock = 1;
     }
 
-    SearchThread *main_thread = &search_threads[thread_id];
+    SearchThread *main_thread = search_threads[thread_id];
     main_thread->root_ply = 2 * (halfmove_clock - 1) + color;
     Position *p = &(main_thread->positions[main_thread->root_ply]);
     main_thread->search_ply = main_thread->root_ply;
@@ -271,7 +271,7 @@ Position* import_fen(std::string fen, int thread_id){
 }
 
 Position* start_pos(){
-    SearchThread *main_thread = &search_threads[0];
+    SearchThread *main_thread = search_threads[0];
     Position *p = &(main_thread->positions[0]);
 
     Bitboard white_occupied_bb = 0x000000000000FFFF;
@@ -28,40 +28,77 @@
 #include <algorithm>
 #include "tb.h"
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include "position.h"
 
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 int myremain = 10000;
 int total_remaining = 10000;
 int moves_to_go = 0;
+bool clock_search = false;
 struct timeval curr_time, start_ts;
 volatile bool is_timeout = false;
+// Set by go ponder and cleared by ponderhit. The main thread notices the switch
+// through still_pondering, so only it touches ponder_search and the clock
+volatile bool is_pondering = false;
+bool ponder_search = false;
 int think_depth_limit = MAX_PLY;
+uint64_t think_node_limit = 0;
+int think_mate_limit = 0;
+int multi_pv = 1;
+bool node_time = false;
+
+// Lazy SMP: how many threads are searching each depth right now. A helper skips
+// depths that enough threads are already on instead of following a fixed offset
+std::atomic<int> threads_at_depth[MAX_PLY + 1];
+
+// ABDADA: the moves some thread is searching, keyed by node, move and depth. A
+// thread that meets one of them searches its other moves first and comes back
+bool defer_moves = false;
+const int defer_min_depth = 5;
+const int searching_moves_size = 1 << 15;
+std::atomic<uint64_t> searching_moves[searching_moves_size];
+
+inline uint64_t searching_key(Position *p, Move move, int depth) {
+    return (p->hash ^ (uint64_t(move) * 0x9E3779B97F4A7C15ULL) ^ uint64_t(depth)) | 1;
+}
 
-std::vector<Move> root_moves = {};
-int depth_increments[MAX_THREADS] = {
-    0, 1, 2, 3, 3, 4, 4, 5,
-    5, 5, 6, 6, 6, 6, 7, 7,
-    7, 7, 7, 7, 8, 8, 8, 8,
-    8, 8, 8, 8, 9, 9, 9, 9,
-    9, 9, 9, 9, 9, 9, 9, 10,
-    10, 10, 10, 10, 10, 10, 10, 10,
-    10, 10, 10, 10, 10, 10, 11, 11,
-    11, 11, 11, 11, 11, 11, 11, 11
-};
+// Workers sleep on pool_cv between searches. Worker 0 runs think for go and
+// the others run thread_think whenever think wakes them up, finishing ones
+// signal done_cv so that they do not wake up the sleeping workers again.
+// When pool_job is set, woken workers run it instead of searching
+std::mutex pool_mutex;
+std::condition_variable pool_cv;
+std::condition_variable done_cv;
+std::thread workers[MAX_THREADS];
+int pool_size = 0;
+bool pool_exit = false;
+std::function<void(int, int)> pool_job;
+int thread_binding = BIND_OFF;
+std::vector<int> binding_cpus;
+bool root_in_check = false;
+Position *go_position;
+std::vector<std::string> go_word_list;
 
 Move pv_at_depth[MAX_PLY * 2];
 int  score_at_depth[MAX_PLY * 2];
 
-void print_pv() {
+void print_pv(PV *line) {
     int i = 0;
-    while (i < pv[0].size) {
-        std::cout << move_to_str(pv[0].moves[i]) << " ";
+    while (i < line->size) {
+        std::cout << move_to_str(line->moves[i]) << " ";
         ++i;
     }
     std::cout << std::endl;
 }
 
-void set_pv(Move move, int ply) {
+void set_pv(SearchThread *thread, Move move, int ply) {
+    PV *pv = thread->pv;
     int s = ply + 1;
     pv[ply].moves[ply] = move;
     pv[ply].size = s;
@@ -112,6 +149,39 @@ void update_history(SearchThread *thread, Piece piece, Square to, int bonus) {
     thread->history[piece][to] += bonus - value * std::abs(bonus) / 16384;
 }
 
+inline void update_stat(int16_t &value, int bonus) {
+    value += bonus - value * std::abs(bonus) / 16384;
+}
+
+void update_continuation_histories(SearchThread *thread, Metadata *md, Piece piece, Square to, int bonus) {
+    PieceToHistory *counter_history = md->ply > 0 ? continuation_history(thread->counter_history, md - 1) : nullptr;
+    if (counter_history) {
+        update_stat((*counter_history)[piece][to], bonus);
+    }
+    PieceToHistory *followup_history = md->ply > 1 ? continuation_history(thread->followup_history, md - 2) : nullptr;
+    if (followup_history) {
+        update_stat((*followup_history)[piece][to], bonus);
+    }
+}
+
+inline int16_t &capture_history_entry(Position *p, Move move) {
+    Square to = move_to(move);
+    return p->my_thread->capture_history[p->pieces[move_from(move)]][to][piece_type(p->pieces[to])];
+}
+
+// The best move gets a bonus if it is a capture, the captures tried before it a malus
+void save_capture(Position *p, Move move, int depth, Move *captures, int captures_count) {
+    int bonus = depth > 17 ? 0 : depth * depth;
+    if (is_capture(p, move)) {
+        update_stat(capture_history_entry(p, move), bonus);
+    }
+    for (int i = 0; i < captures_count; ++i) {
+        if (captures[i] != move) {
+            update_stat(capture_history_entry(p, captures[i]), -bonus);
+        }
+    }
+}
+
 void save_killer(Position *p, Metadata *md, Move move, int depth, Move *quiets, int quiets_count) {
     SearchThread *my_thread = p->my_thread;
     if (move != md->killers[0]) {
@@ -121,10 +191,12 @@ void save_killer(Position *p, Metadata *md, Move move, int depth, Move *quiets,
     Piece piece = p->pieces[move_from(move)];
     int bonus = depth > 17 ? 0 : depth * depth;
     update_history(my_thread, piece, move_to(move), bonus);
+    update_continuation_histories(my_thread, md, piece, move_to(move), bonus);
 
     for (int i = 0; i < quiets_count; ++i) {
         Move q = quiets[i];
         update_history(my_thread, p->pieces[move_from(q)], move_to(q), -bonus);
+        update_continuation_histories(my_thread, md, p->pieces[move_from(q)], move_to(q), -bonus);
     }
 
     if ((md-1)->current_move) {
@@ -135,11 +207,64 @@ void save_killer(Position *p, Metadata *md, Move move, int depth, Move *quiets,
     }
 }
 
+inline RootMove new_root_move(Move move) {
+    RootMove rm = {};
+    rm.move = move;
+    rm.score = rm.previous_score = -MATE;
+    return rm;
+}
+
+// The root is searched in the order of the previous iteration's results. Root
+// moves before pv_index already have a MultiPV line at this depth
+inline bool compare_root_moves(const RootMove &a, const RootMove &b) {
+    return a.score != b.score ? a.score > b.score : a.previous_score > b.previous_score;
+}
+
+inline RootMove *next_root_move(SearchThread *thread, size_t &index) {
+    return index < thread->root_moves.size() ? &thread->root_moves[index++] : nullptr;
+}
+
+inline TTEntry *probe_tte(Position *p, uint64_t hash, TTEntry &tte, bool &tt_hit) {
+    TTEntry *tt_slot = get_tte(hash, tte, tt_hit);
+    TT_STAT(p->my_thread, probes);
+    if (tt_hit) {
+        TT_STAT(p->my_thread, hits);
+    }
+    return tt_slot;
+}
+
+inline void store_tte(Position *p, uint64_t hash, TTEntry *tt_slot, Move move, int depth, int score, int static_eval, uint8_t flag) {
+    TTStoreType store_type = set_tte(hash, tt_slot, move, depth, score, static_eval, flag);
+    TT_STAT(p->my_thread, stores[store_type]);
+    (void) store_type;
+}
+
+// A ponder search has no time limits, the clock starts at ponderhit
+bool still_pondering() {
+    if (ponder_search && !is_pondering) {
+        ponder_search = false;
+        gettimeofday(&start_ts, NULL);
+        curr_time = start_ts;
+    }
+    return ponder_search;
+}
+
+// No bestmove may be sent before ponderhit or stop
+void wait_while_pondering() {
+    while (is_pondering && !is_timeout) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
 bool check_time(Position *p) {
     if (is_main_thread(p)) {
         if (timer_count == 0) {
             gettimeofday(&curr_time, NULL);
-            if (time_passed() > total_remaining) {
+            if (!still_pondering() && time_passed() > total_remaining) {
+                is_timeout = true;
+                return true;
+            }
+            if (think_node_limit && sum_nodes() >= think_node_limit) {
                 is_timeout = true;
                 return true;
             }
@@ -155,9 +280,7 @@ int alpha_beta_quiescence(Position *p, Metadata *md, int alpha, int beta, int de
     assert(in_check == is_checked(p));
 
     int ply = md->ply;
-    if (is_main_thread(p)) {
-        pv[ply].size = 0;
-    }
+    p->my_thread->pv[ply].size = 0;
     if (ply >= MAX_PLY) {
         return evaluate(p);
     }
@@ -173,17 +296,19 @@ int alpha_beta_quiescence(Position *p, Metadata *md, int alpha, int beta, int de
 
     Move tte_move = no_move;
     bool tt_hit;
-    TTEntry *tte = get_tte(p->hash, tt_hit);
+    TTEntry tte;
+    TTEntry *tt_slot = probe_tte(p, p->hash, tte, tt_hit);
     int tte_score;
     tte_score = md->static_eval = UNDEFINED;
     if (tt_hit) {
-        tte_move = tte->move;
-        if (tte->depth >= new_depth) {
-            tte_score = tt_to_score(tte->score, ply);
+        tte_move = tte.move;
+        if (tte.depth >= new_depth) {
+            tte_score = tt_to_score(tte.score, ply);
             if (!is_principal &&
-                (tte_flag(tte) == FLAG_EXACT ||
-                (tte_flag(tte) == FLAG_BETA && tte_score >= beta) ||
-                (tte_flag(tte) == FLAG_ALPHA && tte_score <= alpha))) {
+                (tte_flag(&tte) == FLAG_EXACT ||
+                (tte_flag(&tte) == FLAG_BETA && tte_score >= beta) ||
+                (tte_flag(&tte) == FLAG_ALPHA && tte_score <= alpha))) {
+                    TT_STAT(p->my_thread, cutoffs[tte_flag(&tte)]);
                     return tte_score;
             }
         }
@@ -192,8 +317,8 @@ int alpha_beta_quiescence(Position *p, Metadata *md, int alpha, int beta, int de
     int best_score;
     if (!in_check) {
         bool is_null = ply > 0 && (md-1)->current_move == null_move;
-        if (tt_hit && tte->static_eval != UNDEFINED) {
-            md->static_eval = best_score = tte->static_eval;
+        if (tt_hit && tte.static_eval != UNDEFINED) {
+            md->static_eval = best_score = tte.static_eval;
         } else if (is_null) {
             md->static_eval = best_score = tempo * 2 - (md-1)->static_eval;
         } else {
@@ -201,7 +326,7 @@ int alpha_beta_quiescence(Position *p, Metadata *md, int alpha, int beta, int de
         }
         if (best_score >= beta) {
             if (!tt_hit) {
-                set_tte(p->hash, tte, 0, new_depth, score_to_tt(best_score, ply), md->static_eval, FLAG_BETA);
+                store_tte(p, p->hash, tt_slot, 0, new_depth, score_to_tt(best_score, ply), md->static_eval, FLAG_BETA);
             }
             return best_score;
         }
@@ -252,26 +377,28 @@ int alpha_beta_quiescence(Position *p, Metadata *md, int alpha, int beta, int de
         Position *position = make_move(p, move);
         ++p->my_thread->nodes;
         md->current_move = move;
+        md->moved_piece = p->pieces[move_from(move)];
         int score = -alpha_beta_quiescence(position, md+1, -beta, -alpha, depth - 1, checks);
         undo_move(position);
         assert(is_timeout || (score >= -MATE && score <= MATE));
 
-        int main_thread_depth = search_threads[0].depth.load(std::memory_order_relaxed);
-        if (is_timeout && main_thread_depth > 1) {
+        // Only the main thread has to finish its first iteration to have a move
+        int main_thread_depth = search_threads[0]->depth.load(std::memory_order_relaxed);
+        if (is_timeout && (main_thread_depth > 1 || !is_main_thread(p))) {
             return TIMEOUT;
         }
 
         if (score > best_score) {
             best_score = score;
             if (score > alpha) {
-                if (is_principal && is_main_thread(p)) {
-                    set_pv(move, ply);
+                if (is_principal) {
+                    set_pv(p->my_thread, move, ply);
                 }
                 best_move = move;
                 if (is_principal && score < beta) {
                     alpha = score;
                 } else {
-                    set_tte(p->hash, tte, move, new_depth, score_to_tt(score, ply), md->static_eval, FLAG_BETA);
+                    store_tte(p, p->hash, tt_slot, move, new_depth, score_to_tt(score, ply), md->static_eval, FLAG_BETA);
                     return score;
                 }
             }
@@ -283,7 +410,7 @@ int alpha_beta_quiescence(Position *p, Metadata *md, int alpha, int beta, int de
     }
 
     uint8_t flag = is_principal && best_move ? FLAG_EXACT : FLAG_ALPHA;
-    set_tte(p->hash, tte, best_move, new_depth, score_to_tt(best_score, ply), md->static_eval, flag);
+    store_tte(p, p->hash, tt_slot, best_move, new_depth, score_to_tt(best_score, ply), md->static_eval, flag);
     assert(best_score >= -MATE && best_score <= MATE);
     return best_score;
 }
@@ -296,9 +423,7 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
     }
 
     int ply = md->ply;
-    if (is_main_thread(p)) {
-        pv[ply].size = 0;
-    }
+    p->my_thread->pv[ply].size = 0;
 
     if (ply >= MAX_PLY) {
         return evaluate(p);
@@ -311,6 +436,8 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
     bool is_principal = beta - alpha > 1;
     bool root_node = is_principal && ply == 0;
     assert(!(is_principal && cut));
+    // The root entry keeps the first MultiPV line
+    bool tt_store = !(root_node && p->my_thread->pv_index);
 
     // Mate distance pruning
     if (!root_node) {
@@ -333,18 +460,20 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
     int tte_score;
     tte_score = md->static_eval = UNDEFINED;
     bool tt_hit;
-    TTEntry *tte = get_tte(pos_hash, tt_hit);
+    TTEntry tte;
+    TTEntry *tt_slot = probe_tte(p, pos_hash, tte, tt_hit);
     if (tt_hit) {
-        tte_move = tte->move;
-        if (tte->depth >= depth) {
-            tte_score = tt_to_score(tte->score, ply);
+        tte_move = tte.move;
+        if (tte.depth >= depth) {
+            tte_score = tt_to_score(tte.score, ply);
             if (!is_principal &&
-                (tte_flag(tte) == FLAG_EXACT ||
-                (tte_flag(tte) == FLAG_BETA && tte_score >= beta) ||
-                (tte_flag(tte) == FLAG_ALPHA && tte_score <= alpha))) {
+                (tte_flag(&tte) == FLAG_EXACT ||
+                (tte_flag(&tte) == FLAG_BETA && tte_score >= beta) ||
+                (tte_flag(&tte) == FLAG_ALPHA && tte_score <= alpha))) {
                     if (tte_score >= beta && !in_check && tte_move && !is_capture_or_promotion(p, tte_move)) {
                         save_killer(p, md, tte_move, depth, nullptr, 0);
                     }
+                    TT_STAT(p->my_thread, cutoffs[tte_flag(&tte)]);
                     return tte_score;
             }
         }
@@ -364,7 +493,7 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
             if (flag == FLAG_EXACT ||
                 (flag == FLAG_BETA && tb_score >= beta) ||
                 (flag == FLAG_ALPHA && tb_score <= alpha)) {
-                    set_tte(pos_hash, tte, 0, std::min(depth + 6, MAX_PLY - 1), score_to_tt(tb_score, ply), UNDEFINED, flag);
+                    store_tte(p, pos_hash, tt_slot, 0, std::min(depth + 6, MAX_PLY - 1), score_to_tt(tb_score, ply), UNDEFINED, flag);
                     return tb_score;
                 }
         }
@@ -372,8 +501,8 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
 
     bool is_null = ply > 0 && (md-1)->current_move == null_move;
     if (!in_check) {
-        if (tt_hit && tte->static_eval != UNDEFINED) {
-            md->static_eval = tte->static_eval;
+        if (tt_hit && tte.static_eval != UNDEFINED) {
+            md->static_eval = tte.static_eval;
         } else if (is_null) {
             md->static_eval = tempo * 2 - (md-1)->static_eval;
         } else {
@@ -434,10 +563,10 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
     if (!tte_move && depth >= 6 && (is_principal || md->static_eval + 150 >= beta)) {
         new_depth = 3 * depth / 4 - 2;
         alpha_beta(p, md, alpha, beta, new_depth, in_check, cut);
-        tte = get_tte(pos_hash, tt_hit);
+        tt_slot = probe_tte(p, pos_hash, tte, tt_hit);
         if (tt_hit) {
-            tte_move = tte->move;
-            tte_score = tt_to_score(tte->score, ply);
+            tte_move = tte.move;
+            tte_score = tt_to_score(tte.score, ply);
         }
     }
 
@@ -446,6 +575,8 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
     Move best_move = no_move;
     Move quiets[64];
     int quiets_count = 0;
+    Move captures[32];
+    int captures_count = 0;
     int best_score = -INFINITE;
     int num_moves = 0;
 
@@ -454,8 +585,18 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
         improving = md->static_eval >= (md-2)->static_eval || (md-2)->static_eval == UNDEFINED;
     }
 
+    Move deferred_moves[64];
+    int deferred_count = 0;
+    int deferred_index = 0;
+    bool deferring = defer_moves && num_threads > 1 && !root_node && depth >= defer_min_depth;
+
+    size_t root_index = p->my_thread->pv_index;
+    RootMove *root_move = nullptr;
+
     Move move;
-    while ((move = next_move(&movegen)) != no_move) {
+    while ((move = root_node ? ((root_move = next_root_move(p->my_thread, root_index)) ? root_move->move : no_move)
+                             : next_move(&movegen)) != no_move ||
+           (deferred_index < deferred_count && (move = deferred_moves[deferred_index++]))) {
         assert(is_pseudolegal(p, move));
         assert(!is_move_empty(move));
         assert(0 < depth || in_check);
@@ -464,10 +605,6 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
             continue;
         }
 
-        if (root_node && !std::count(root_moves.begin(), root_moves.end(), move)) {
-            continue;
-        }
-
         ++num_moves;
 
         bool checks = gives_check(p, move);
@@ -480,8 +617,8 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
             !root_node &&
             excluded_move == no_move &&
             tte_score != UNDEFINED && std::abs(tte_score) < MATE_IN_MAX_PLY &&
-            (tte_flag(tte) == FLAG_EXACT || tte_flag(tte) == FLAG_BETA) &&
-            tte->depth >= depth - 3 &&
+            (tte_flag(&tte) == FLAG_EXACT || tte_flag(&tte) == FLAG_BETA) &&
+            tte.depth >= depth - 3 &&
             is_legal(p, move)) {
                 int rbeta = std::max(tte_score - 2 * depth, -MATE + 1);
                 md->excluded_move = move;
@@ -520,12 +657,33 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
             continue;
         }
 
+        uint64_t searching = 0;
+        if (deferring) {
+            uint64_t key = searching_key(p, move, depth);
+            std::atomic<uint64_t> *slot = &searching_moves[key & (searching_moves_size - 1)];
+            // Moves that come back from the deferred list are searched either way
+            if (num_moves > 1 && deferred_index == 0 && deferred_count < 64 && slot->load(std::memory_order_relaxed) == key) {
+                deferred_moves[deferred_count++] = move;
+                --num_moves;
+                continue;
+            }
+            uint64_t empty = 0;
+            if (slot->compare_exchange_strong(empty, key, std::memory_order_relaxed)) {
+                searching = key;
+            }
+        }
+
+        uint64_t nodes_before = p->my_thread->nodes.load(std::memory_order_relaxed);
         Position *position = make_move(p, move);
         ++p->my_thread->nodes;
         md->current_move = move;
+        md->moved_piece = p->pieces[move_from(move)];
         if (!capture_or_promo && quiets_count < 64) {
             quiets[quiets_count++] = move;
         }
+        if (capture_or_promo && captures_count < 32 && is_capture(p, move)) {
+            captures[captures_count++] = move;
+        }
 
         int score;
 
@@ -565,16 +723,29 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
         undo_move(position);
         assert(is_timeout || (score >= -MATE && score <= MATE));
 
-        int main_thread_depth = search_threads[0].depth.load(std::memory_order_relaxed);
-        if ((is_timeout || check_time(p)) && main_thread_depth > 1) {
+        if (root_node) {
+            root_move->nodes += p->my_thread->nodes.load(std::memory_order_relaxed) - nodes_before;
+        }
+
+        if (searching) {
+            searching_moves[searching & (searching_moves_size - 1)].compare_exchange_strong(searching, 0, std::memory_order_relaxed);
+        }
+
+        int main_thread_depth = search_threads[0]->depth.load(std::memory_order_relaxed);
+        if ((is_timeout || check_time(p)) && (main_thread_depth > 1 || !is_main_thread(p))) {
             return TIMEOUT;
         }
 
+        // Only the first move and the ones raising alpha have a score worth sorting by
+        if (root_node) {
+            root_move->score = num_moves == 1 || score > alpha ? score : -MATE;
+        }
+
         if (score > best_score) {
             best_score = score;
             if (score > alpha) {
-                if (is_principal && is_main_thread(p)) {
-                    set_pv(move, ply);
+                if (is_principal) {
+                    set_pv(p->my_thread, move, ply);
                 }
                 best_move = move;
                 if (is_principal && score < beta) {
@@ -583,8 +754,9 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
                     if (!capture_or_promo) {
                         save_killer(p, md, move, depth, quiets, quiets_count - 1);
                     }
-                    if (excluded_move == no_move) {
-                        set_tte(pos_hash, tte, move, depth, score_to_tt(score, ply), md->static_eval, FLAG_BETA);
+                    save_capture(p, move, depth, captures, captures_count);
+                    if (excluded_move == no_move && tt_store) {
+                        store_tte(p, pos_hash, tt_slot, move, depth, score_to_tt(score, ply), md->static_eval, FLAG_BETA);
                     }
                     return score;
                 }
@@ -596,105 +768,187 @@ int alpha_beta(Position *p, Metadata *md, int alpha, int beta, int depth, bool i
         best_score = excluded_move != no_move ? alpha : in_check ? -MATE + ply : 0;
     }
 
-    if (excluded_move == no_move) {
+    if (excluded_move == no_move && tt_store) {
         uint8_t flag = is_principal && best_move ? FLAG_EXACT : FLAG_ALPHA;
-        set_tte(pos_hash, tte, best_move, depth, score_to_tt(best_score, ply), md->static_eval, flag);
+        store_tte(p, pos_hash, tt_slot, best_move, depth, score_to_tt(best_score, ply), md->static_eval, flag);
     }
     if (!in_check && best_move && !is_capture_or_promotion(p, best_move)) {
         save_killer(p, md, best_move, depth, quiets, quiets_count - 1);
     }
+    if (best_move) {
+        save_capture(p, best_move, depth, captures, captures_count);
+    }
     assert(best_score >= -MATE && best_score <= MATE);
     return best_score;
 }
 
+void print_info(int depth, int line, RootMove *rm) {
+    gettimeofday(&curr_time, NULL);
+    int time_taken = time_passed();
+    uint64_t tb_hits = sum_tb_hits();
+    std::cout << "info depth " << depth << " seldepth " << rm->pv.size << " multipv " << line + 1 << " ";
+    std::cout << "tbhits " << tb_hits << " score ";
+
+    if (rm->score <= MATED_IN_MAX_PLY) {
+        std::cout << "mate " << ((-MATE - rm->score) / 2 + 1);
+    } else if (rm->score >= MATE_IN_MAX_PLY) {
+        std::cout << "mate " << ((MATE - rm->score) / 2 + 1);
+    } else {
+        std::cout << "cp " << rm->score * 100 / PAWN_END;
+    }
+
+    std::cout << " hashfull " << hashfull();
+
+    uint64_t nodes = sum_nodes();
+    std::cout << " nodes " << nodes <<  " nps " << nodes*1000/(time_taken+1) << " time " << time_taken << " pv ";
+    print_pv(&rm->pv);
+}
+
+// NodeTime: a best move that took most of the root nodes is unlikely to change and
+// the search can stop early. A small share, or a best move that keeps changing,
+// gets more time. Returns true to stop, every decision goes to an info string
+bool node_time_management(std::vector<RootMove> &root_moves, int depth, int init_remain) {
+    uint64_t iteration_nodes = 0;
+    for (RootMove &rm : root_moves) {
+        iteration_nodes += rm.nodes;
+    }
+    uint64_t best_share = root_moves[0].nodes * 100 / std::max(iteration_nodes, uint64_t(1));
+
+    int best_move_changes = 0;
+    for (int i = depth - 3; i < depth; ++i) {
+        best_move_changes += pv_at_depth[i] != pv_at_depth[i - 1];
+    }
+
+    int time_taken = time_passed();
+    if (best_share >= 90 && best_move_changes == 0 && time_taken > myremain / 2) {
+        std::cout << "info string nodetime depth " << depth << " share " << best_share << " changes "
+                  << best_move_changes << " stop at " << time_taken << " of " << myremain << " ms" << std::endl;
+        return true;
+    }
+    int extended = std::min(init_remain * 3 / 2, total_remaining);
+    if ((best_share < 30 || best_move_changes >= 2) && extended > myremain) {
+        std::cout << "info string nodetime depth " << depth << " share " << best_share << " changes "
+                  << best_move_changes << " extend " << myremain << " to " << extended << " ms" << std::endl;
+        myremain = extended;
+    }
+    return false;
+}
+
 void thread_think(SearchThread *my_thread, bool in_check) {
     Position *p = &my_thread->positions[my_thread->search_ply];
     Metadata *md = &my_thread->metadatas[0];
     bool is_main = is_main_thread(p);
+    std::vector<RootMove> &root_moves = my_thread->root_moves;
+    int lines = std::min(multi_pv, int(root_moves.size()));
+    if (lines == 0) {
+        return;
+    }
 
-    int previous_guess = -MATE;
-    int current_guess = -MATE;
     int init_remain = myremain;
     int depth = 0;
 
     while (++depth <= think_depth_limit) {
         if (!is_main) {
-            int main_thread_depth = search_threads[0].depth.load(std::memory_order_relaxed);
-            depth = main_thread_depth + depth_increments[my_thread->thread_id];
+            // Depths below the main thread's are of no use anymore
+            int main_thread_depth = search_threads[0]->depth.load(std::memory_order_relaxed);
+            depth = std::max(depth, main_thread_depth);
+            while (depth < think_depth_limit && threads_at_depth[depth].load(std::memory_order_relaxed) >= (num_threads + 1) / 2) {
+                ++depth;
+            }
         }
 
         my_thread->depth = depth;
+        threads_at_depth[depth].fetch_add(1, std::memory_order_relaxed);
 
-        int aspiration = 10;
-        int alpha = -MATE;
-        int beta = MATE;
-
-        if (depth >= 5) {
-            alpha = std::max(previous_guess - aspiration, -MATE);
-            beta = std::min(previous_guess + aspiration, MATE);
+        for (RootMove &rm : root_moves) {
+            rm.previous_score = rm.score;
+            rm.nodes = 0;
         }
 
+        // Each MultiPV line is searched with its own aspiration window, without
+        // the root moves of the lines before it
         bool failed_low = false;
-        while (true) {
-            int score = alpha_beta(p, md, alpha, beta, depth, in_check, false);
+        for (my_thread->pv_index = 0; my_thread->pv_index < lines; ++my_thread->pv_index) {
+            int pv_index = my_thread->pv_index;
+            int previous_guess = root_moves[pv_index].previous_score;
+            int current_guess = -MATE;
+            int aspiration = 10;
+            int alpha = -MATE;
+            int beta = MATE;
+
+            if (depth >= 5) {
+                alpha = std::max(previous_guess - aspiration, -MATE);
+                beta = std::min(previous_guess + aspiration, MATE);
+            }
 
-            current_guess = score;
+            while (true) {
+                int score = alpha_beta(p, md, alpha, beta, depth, in_check, false);
 
-            if (is_timeout) {
-                break;
+                current_guess = score;
+
+                if (is_timeout) {
+                    break;
+                }
+
+                if (score <= alpha) {
+                    beta = (alpha + beta) / 2;
+                    alpha = std::max(score - aspiration, -MATE);
+                    failed_low = failed_low || pv_index == 0;
+                } else if (score >= beta) {
+                    beta = std::min(score + aspiration, MATE);
+                } else {
+                    break;
+                }
+
+                aspiration += aspiration / 2;
+                assert(alpha >= -MATE && beta <= MATE);
             }
 
-            if (score <= alpha) {
-                beta = (alpha + beta) / 2;
-                alpha = std::max(score - aspiration, -MATE);
-                failed_low = true;
-            } else if (score >= beta) {
-                beta = std::min(score + aspiration, MATE);
-            } else {
+            if (is_timeout) {
                 break;
             }
 
-            aspiration += aspiration / 2;
-            assert(alpha >= -MATE && beta <= MATE);
+            // The best move of the line comes first, the others are ordered for the next line
+            std::stable_sort(root_moves.begin() + pv_index, root_moves.end(), compare_root_moves);
+            RootMove &rm = root_moves[pv_index];
+            assert(rm.score == current_guess);
+            (void) current_guess;
+            rm.depth = depth;
+            rm.pv = my_thread->pv[0];
         }
 
-        previous_guess = current_guess;
+        threads_at_depth[depth].fetch_sub(1, std::memory_order_relaxed);
 
         if (is_timeout) {
             break;
         }
 
+        std::stable_sort(root_moves.begin(), root_moves.begin() + lines, compare_root_moves);
+
+        my_thread->best_move = root_moves[0].move;
+        my_thread->best_score = root_moves[0].score;
+        my_thread->completed_depth = depth;
+
         if (!is_main) {
             continue;
         }
 
-        gettimeofday(&curr_time, NULL);
-        int time_taken = time_passed();
-        uint64_t tb_hits = sum_tb_hits();
-        std::cout << "info depth " << depth << " seldepth " << pv[0].size << " multipv 1 ";
-        std::cout << "tbhits " << tb_hits << " score ";
-
-        if (current_guess <= MATED_IN_MAX_PLY) {
-            std::cout << "mate " << ((-MATE - current_guess) / 2 + 1);
-        } else if (current_guess >= MATE_IN_MAX_PLY) {
-            std::cout << "mate " << ((MATE - current_guess) / 2 + 1);
-        } else {
-            std::cout << "cp " << current_guess * 100 / PAWN_END;
+        for (int i = 0; i < lines; ++i) {
+            print_info(depth, i, &root_moves[i]);
         }
 
-        std::cout << " hashfull " << hashfull();
-
-        uint64_t nodes = sum_nodes();
-        std::cout << " nodes " << nodes <<  " nps " << nodes*1000/(time_taken+1) << " time " << time_taken << " pv ";
-        print_pv();
+        // go mate N is done once a mate in N moves or less is proven
+        if (think_mate_limit && root_moves[0].score >= MATE - 2 * think_mate_limit + 1) {
+            break;
+        }
 
-        if (time_passed() > myremain) {
+        if (!still_pondering() && time_passed() > myremain) {
             is_timeout = true;
             break;
         }
 
-        pv_at_depth[depth - 1] = pv[0].moves[0];
-        score_at_depth[depth - 1] = current_guess;
+        pv_at_depth[depth - 1] = root_moves[0].move;
+        score_at_depth[depth - 1] = root_moves[0].score;
 
         if (depth >= 6) {
             if (depth >= 10 && failed_low) {
@@ -713,12 +967,294 @@ void thread_think(SearchThread *my_thread, bool in_check) {
             } else {
                 myremain = std::max(init_remain, myremain);
             }
+
+            if (node_time && clock_search && lines == 1 && !ponder_search && node_time_management(root_moves, depth, init_remain)) {
+                is_timeout = true;
+                break;
+            }
+        }
+    }
+
+    // Lines after the first one leave their own moves in the PV
+    if (is_main && lines > 1 && root_moves[0].depth) {
+        my_thread->pv[0] = root_moves[0].pv;
+    }
+}
+
+void wake_threads(int first, int last) {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        for (int i = first; i < last; ++i) {
+            search_threads[i]->searching = true;
+        }
+    }
+    pool_cv.notify_all();
+}
+
+void wait_for_threads(int first, int last) {
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    done_cv.wait(lock, [first, last] {
+        for (int i = first; i < last; ++i) {
+            if (search_threads[i]->searching) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+#if defined(__linux__)
+// The CPUs that workers are pinned to, worker i gets the i-th one
+std::vector<int> binding_order() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    std::vector<std::vector<int>> nodes;
+    for (int node : read_id_list("/sys/devices/system/node/online")) {
+        std::vector<int> cpus;
+        for (int cpu : read_id_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty()) {
+            nodes.push_back(cpus);
+        }
+    }
+    if (nodes.empty()) {
+        // No NUMA information, treat the machine as a single node
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        nodes.push_back(cpus);
+    }
+
+    std::vector<int> order;
+    if (thread_binding == BIND_COMPACT) {
+        for (std::vector<int> &cpus : nodes) {
+            order.insert(order.end(), cpus.begin(), cpus.end());
+        }
+    } else {
+        for (size_t i = 0, added = 1; added; ++i) {
+            added = 0;
+            for (std::vector<int> &cpus : nodes) {
+                if (i < cpus.size()) {
+                    order.push_back(cpus[i]);
+                    ++added;
+                }
+            }
+        }
+    }
+    return order;
+}
+
+void bind_thread(int thread_id) {
+    if (thread_binding == BIND_OFF || binding_cpus.empty()) {
+        return;
+    }
+    cpu_set_t cpu;
+    CPU_ZERO(&cpu);
+    CPU_SET(binding_cpus[thread_id % binding_cpus.size()], &cpu);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu), &cpu);
+}
+#else
+std::vector<int> binding_order() {
+    return std::vector<int>();
+}
+
+void bind_thread(int thread_id) {
+    (void) thread_id;
+}
+#endif
+
+void idle_loop(int thread_id) {
+    // Pinned before the state is allocated so that it is first touched on its node
+    bind_thread(thread_id);
+
+    // Threads that already had a worker keep their state, histories included
+    if (!search_threads[thread_id]) {
+        SearchThread *t = new_search_thread(thread_id);
+        allocate_thread_tables(t);
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            search_threads[thread_id] = t;
+        }
+        done_cv.notify_all();
+    }
+
+    SearchThread *t = search_threads[thread_id];
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(pool_mutex);
+            pool_cv.wait(lock, [t] { return t->searching || pool_exit; });
+            if (pool_exit) {
+                return;
+            }
+        }
+
+        if (pool_job) {
+            pool_job(t->thread_id, pool_size);
+        } else if (t->thread_id == 0) {
+            think(go_position, go_word_list);
+        } else {
+            thread_think(t, root_in_check);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            t->searching = false;
+        }
+        done_cv.notify_all();
+    }
+}
+
+void destroy_pool() {
+    wait_for_threads(0, pool_size);
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pool_exit = true;
+    }
+    pool_cv.notify_all();
+    for (int i = 0; i < pool_size; ++i) {
+        workers[i].join();
+    }
+    pool_size = 0;
+}
+
+void init_pool() {
+    destroy_pool();
+    for (int i = num_threads; i < MAX_THREADS; ++i) {
+        if (search_threads[i]) {
+            free_search_thread(search_threads[i]);
+            search_threads[i] = nullptr;
+        }
+    }
+
+    pool_exit = false;
+    pool_size = num_threads;
+    binding_cpus = thread_binding == BIND_OFF ? std::vector<int>() : binding_order();
+    for (int i = 0; i < pool_size; ++i) {
+        workers[i] = std::thread(idle_loop, i);
+    }
+
+    // Nothing may use a thread before its worker has set it up
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    done_cv.wait(lock, [] {
+        for (int i = 0; i < pool_size; ++i) {
+            if (!search_threads[i]) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void run_on_pool(std::function<void(int, int)> job) {
+    if (!pool_size) {
+        job(0, 1);
+        return;
+    }
+    wait_for_threads(0, pool_size);
+    pool_job = job;
+    wake_threads(0, pool_size);
+    wait_for_threads(0, pool_size);
+    pool_job = nullptr;
+}
+
+void start_thinking(Position *p, std::vector<std::string> word_list) {
+    // A go is only sent after the previous search has stopped
+    wait_for_threads(0, 1);
+
+    // go ponder is a normal go whose time limits start at ponderhit
+    std::vector<std::string>::iterator ponder = std::find(word_list.begin(), word_list.end(), "ponder");
+    is_pondering = ponder != word_list.end();
+    if (is_pondering) {
+        word_list.erase(ponder);
+    }
+    // Reset here rather than in think so that a stop right after go is not lost
+    is_timeout = false;
+    go_position = p;
+    go_word_list = word_list;
+    wake_threads(0, 1);
+}
+
+void wait_for_search() {
+    wait_for_threads(0, 1);
+}
+
+// Helpers often complete deeper iterations than the main thread. Every thread votes
+// for its best move with the depth it completed and its score above the worst one
+SearchThread *vote_best_thread() {
+    SearchThread *best_thread = search_threads[0];
+    int min_score = MATE;
+    for (int i = 0; i < num_threads; ++i) {
+        if (search_threads[i]->completed_depth) {
+            min_score = std::min(min_score, search_threads[i]->best_score);
+        }
+    }
+
+    uint64_t votes[MAX_THREADS] = {};
+    for (int i = 0; i < num_threads; ++i) {
+        SearchThread *t = search_threads[i];
+        if (!t->completed_depth) {
+            continue;
+        }
+        uint64_t vote = uint64_t(t->best_score - min_score + PAWN_END / 8) * t->completed_depth;
+        for (int j = 0; j <= i; ++j) {
+            if (search_threads[j]->best_move == t->best_move) {
+                votes[j] += vote;
+                break;
+            }
+        }
+    }
+
+    uint64_t best_votes = votes[0];
+    for (int i = 1; i < num_threads; ++i) {
+        SearchThread *t = search_threads[i];
+        if (!t->completed_depth) {
+            continue;
+        }
+        // A mate found by any thread is taken as is, the shortest one first
+        if (best_thread->best_score >= MATE_IN_MAX_PLY || t->best_score >= MATE_IN_MAX_PLY) {
+            if (t->best_score > best_thread->best_score) {
+                best_thread = t;
+            }
+            continue;
+        }
+        if (votes[i] > best_votes) {
+            best_votes = votes[i];
+            best_thread = t;
+        }
+    }
+    return best_thread;
+}
+
+void generate_root_moves(Position *p, Metadata *md, bool in_check, std::vector<std::string> &search_moves) {
+    std::vector<RootMove> &root_moves = p->my_thread->root_moves;
+    MoveGen movegen = new_movegen(p, md, 0, no_move, LEGAL_SEARCH, in_check);
+    Move move;
+    while ((move = next_move(&movegen)) != no_move) {
+        if (search_moves.empty() || std::count(search_moves.begin(), search_moves.end(), move_to_str(move))) {
+            root_moves.push_back(new_root_move(move));
         }
     }
 }
 
 void think(Position *p, std::vector<std::string> word_list) {
+    // searchmoves takes the rest of the command
+    std::vector<std::string> search_moves;
+    std::vector<std::string>::iterator searchmoves = std::find(word_list.begin(), word_list.end(), "searchmoves");
+    if (searchmoves != word_list.end()) {
+        search_moves.assign(searchmoves + 1, word_list.end());
+        word_list.erase(searchmoves, word_list.end());
+    }
+
     init_time(p, word_list);
+    ponder_search = is_pondering;
 
     // Set the table generation
     start_search();
@@ -730,28 +1266,39 @@ void think(Position *p, std::vector<std::string> word_list) {
     Metadata *md = &main_thread->metadatas[0];
 
     // Clear root moves
+    std::vector<RootMove> &root_moves = main_thread->root_moves;
     root_moves.clear();
 
-    int wdl = probe_syzygy_dtz(p, &tb_move);
+    // The tablebase move may not be one of the searchmoves
+    int wdl = search_moves.empty() ? probe_syzygy_dtz(p, &tb_move) : SYZYGY_FAIL;
     if (wdl != SYZYGY_FAIL) {
         // Return draws immediately
         if (wdl == SYZYGY_DRAW) {
             std::cout << "info score cp 0" << std::endl;
+            wait_while_pondering();
             std::cout << "bestmove " << move_to_str(tb_move) << std::endl;
             return;
         }
-        root_moves.push_back(tb_move);
+        root_moves.push_back(new_root_move(tb_move));
     } else {
         Material *eval_material = get_material(p);
-        MoveGen movegen = new_movegen(p, md, 0, no_move, NORMAL_SEARCH, in_check);
-        Move move;
-        while ((move = next_move(&movegen)) != no_move) {
-            if (is_legal(p, move)) {
-                root_moves.push_back(move);
-            }
+        generate_root_moves(p, md, in_check, search_moves);
+        if (root_moves.empty() && !search_moves.empty()) {
+            // None of the searchmoves is legal here, search all moves instead
+            search_moves.clear();
+            generate_root_moves(p, md, in_check, search_moves);
+        }
+        // Checkmate or stalemate, there is nothing to search
+        if (root_moves.empty()) {
+            std::cout << "info depth 0 score " << (in_check ? "mate 0" : "cp 0") << std::endl;
+            wait_while_pondering();
+            std::cout << "bestmove 0000" << std::endl;
+            return;
         }
-        if (eval_material->endgame_type == DRAW_ENDGAME || root_moves.size() == 1) {
-            std::cout << "bestmove " << move_to_str(root_moves[0]) << std::endl;
+        // A single searchmove is still searched, for its score
+        if (eval_material->endgame_type == DRAW_ENDGAME || (root_moves.size() == 1 && search_moves.empty())) {
+            wait_while_pondering();
+            std::cout << "bestmove " << move_to_str(root_moves[0].move) << std::endl;
             return;
         }
     }
@@ -761,28 +1308,56 @@ void think(Position *p, std::vector<std::string> word_list) {
     std::memset(score_at_depth, 0, sizeof(score_at_depth));
 
     initialize_threads();
-    for (int i = 0; i < num_threads; ++i) {
-        SearchThread *t = &search_threads[i];
-        t->thread_obj = std::thread(thread_think, t, in_check);
+    for (int i = 0; i <= MAX_PLY; ++i) {
+        threads_at_depth[i] = 0;
     }
-
-    // Stop threads
-    for (int i = 0; i < num_threads; ++i) {
-        SearchThread *t = &search_threads[i];
-        t->thread_obj.join();
+    if (defer_moves) {
+        for (int i = 0; i < searching_moves_size; ++i) {
+            searching_moves[i].store(0, std::memory_order_relaxed);
+        }
     }
+    for (int i = 1; i < num_threads; ++i) {
+        search_threads[i]->root_moves = root_moves;
+    }
+    root_in_check = in_check;
+    wake_threads(1, num_threads);
+    thread_think(main_thread, in_check);
+    wait_while_pondering();
+
+    // Helpers may be deeper than a depth limit, their results are not used anymore
+    is_timeout = true;
+    wait_for_threads(1, num_threads);
 
     gettimeofday(&curr_time, NULL);
     std::cout << "info time " << time_passed() << std::endl;
-    std::cout << "bestmove " << move_to_str(pv[0].moves[0]);
-    if (pv[0].size > 1) {
-        std::cout << " ponder " << move_to_str(pv[0].moves[1]);
+#ifdef __TTSTATS__
+    print_tt_stats();
+#endif
+    // A depth limit or MultiPV asks for the main thread's lines
+    SearchThread *best_thread = main_thread;
+    if (num_threads > 1 && think_depth_limit == MAX_PLY && multi_pv == 1) {
+        best_thread = vote_best_thread();
+    }
+    PV *line = &main_thread->pv[0];
+    if (best_thread != main_thread && best_thread->best_move != line->moves[0]) {
+        std::cout << "info string bestmove from thread " << best_thread->thread_id << " at depth "
+                  << best_thread->completed_depth << std::endl;
+        // The line of the winner's last completed iteration, which starts with its best move
+        line = &best_thread->root_moves[0].pv;
+        assert(line->moves[0] == best_thread->best_move);
+    }
+
+    std::cout << "bestmove " << move_to_str(line->moves[0]);
+    if (line->size > 1) {
+        std::cout << " ponder " << move_to_str(line->moves[1]);
     }
     std::cout << std::endl;
 }
 
 void bench() {
     uint64_t nodes = 0;
+    uint64_t eval_probes = 0, eval_hits = 0;
+    int clear_time = 0;
     std::vector<std::string> empty_word_list;
 
     struct timeval bench_start, bench_end;
@@ -790,28 +1365,103 @@ void bench() {
     int tmp_depth = think_depth_limit;
     int tmp_myremain = myremain;
     think_depth_limit = 13;
-    is_timeout = false;
 
     for (int i = 0; i < 36; i++){
         std::cout << "\nPosition [" << (i + 1) << "|36]\n" << std::endl;
         Position *p = import_fen(benchmarks[i], 0);
+        get_ready();
 
         myremain = 3600000;
+        is_timeout = false;
         think(p, empty_word_list);
-        nodes += search_threads[0].nodes;
+        nodes += sum_nodes();
+        for (int t = 0; t < num_threads; ++t) {
+            eval_probes += search_threads[t]->eval_probes;
+            eval_hits += search_threads[t]->eval_hits;
+        }
 
-        clear_tt();
+        clear_time += clear_tt();
     }
 
     gettimeofday(&bench_end, nullptr);
-    int time_taken = bench_time(bench_start, bench_end);
+    // Clearing a large hash between positions is not search time
+    int time_taken = bench_time(bench_start, bench_end) - clear_time;
     think_depth_limit = tmp_depth;
     myremain = tmp_myremain;
 
     std::cout << "\n------------------------\n";
     std::cout << "Time  : " << time_taken << std::endl;
+    std::cout << "Clear : " << clear_time << std::endl;
     std::cout << "Nodes : " << nodes << std::endl;
     std::cout << "NPS   : " << nodes * 1000 / (time_taken + 1) << std::endl;
+    std::cout << "Evals : " << eval_probes << ", " << eval_hits * 100 / (eval_probes + 1) << "% from the eval cache" << std::endl;
+    destroy_pool();
     exit(EXIT_SUCCESS);
 }
 
+GameState save_game_state() {
+    SearchThread *main_thread = search_threads[0];
+    GameState state = {
+        std::vector<Position>(std::begin(main_thread->positions), std::end(main_thread->positions)),
+        main_thread->root_ply,
+        main_thread->search_ply
+    };
+    return state;
+}
+
+void restore_game_state(GameState &state) {
+    SearchThread *main_thread = search_threads[0];
+    std::copy(state.positions.begin(), state.positions.end(), main_thread->positions);
+    main_thread->root_ply = state.root_ply;
+    main_thread->search_ply = state.search_ply;
+}
+
+void smp_bench(int depth) {
+    const int thread_counts[6] = {1, 2, 4, 8, 16, 32};
+    int results[6][2] = {};
+    std::vector<std::string> empty_word_list;
+
+    int tmp_threads = num_threads;
+    int tmp_depth = think_depth_limit;
+    int tmp_myremain = myremain;
+    GameState game = save_game_state();
+    think_depth_limit = depth;
+
+    for (int t = 0; t < 6; ++t) {
+        num_threads = std::min(thread_counts[t], MAX_THREADS);
+        init_pool();
+        uint64_t nodes = 0;
+        int time_taken = 0;
+        for (int i = 0; i < 36; i++) {
+            clear_tt();
+            Position *p = import_fen(benchmarks[i], 0);
+            get_ready();
+
+            myremain = 3600000;
+            is_timeout = false;
+            struct timeval start, end;
+            gettimeofday(&start, nullptr);
+            think(p, empty_word_list);
+            gettimeofday(&end, nullptr);
+            time_taken += bench_time(start, end);
+            nodes += sum_nodes();
+        }
+        results[t][0] = time_taken;
+        results[t][1] = int(nodes / 1000);
+    }
+
+    num_threads = tmp_threads;
+    think_depth_limit = tmp_depth;
+    myremain = tmp_myremain;
+    init_pool();
+    restore_game_state(game);
+    get_ready();
+
+    // Time to depth over all positions, the speedup is against a single thread
+    std::cout << "\n------------------------\n";
+    std::cout << "Depth " << depth << std::endl;
+    for (int t = 0; t < 6; ++t) {
+        std::cout << "Threads " << thread_counts[t] << " : " << results[t][0] << " ms, " << results[t][1] << "k nodes, speedup "
+                  << double(results[0][0]) / std::max(results[t][0], 1) << std::endl;
+    }
+}
@@ -24,6 +24,7 @@
 #include "eval.h"
 #include <algorithm>
 #include <vector>
+#include <functional>
 #include "timecontrol.h"
 
 const int razoring_margin[4] = {0, 333, 353, 324};
@@ -40,8 +41,25 @@ inline int lmr(bool is_pv, int depth, int num_moves) {
 extern int myremain;
 extern int total_remaining;
 extern int moves_to_go;
+extern bool clock_search; // Timed by the side's clock, not by movetime or a limit
 extern volatile bool is_timeout;
+extern volatile bool is_pondering;
 extern int think_depth_limit;
+extern uint64_t think_node_limit;
+extern int think_mate_limit;
+
+enum ThreadBinding {
+    BIND_OFF,
+    BIND_SPREAD, // Round robin over the NUMA nodes
+    BIND_COMPACT // Fill up one node before the next
+};
+
+extern int thread_binding;
+extern bool defer_moves;
+extern int multi_pv;
+// The root moves' node counts only steer the clock when NodeTime is on. It is off by
+// default, and the default time management then looks at PV and score changes alone
+extern bool node_time;
 
 extern struct timeval curr_time, start_ts;
 
@@ -59,28 +77,41 @@ inline void init_time(Position *p, std::vector<std::string> word_list) {
         return;
     }
 
-    is_timeout = false;
     int black_remaining = 0;
     int white_remaining = 0;
     int black_increment = 0;
     int white_increment = 0;
     moves_to_go = 0;
+    clock_search = false;
     think_depth_limit = MAX_PLY;
+    think_node_limit = 0;
+    think_mate_limit = 0;
 
-    if (word_list[1] == "movetime") {
+    // A bare go, also what is left of a bare go ponder, searches until stop
+    if (word_list.size() == 1 || word_list[1] == "infinite") {
         moves_to_go = 1;
-        myremain = stoi(word_list[2]) * 99 / 100;
-        total_remaining = myremain;
+        myremain = 3600000;
     }
-    else if (word_list[1] == "infinite") {
+    else if (word_list[1] == "movetime") {
         moves_to_go = 1;
-        myremain = 3600000;
+        myremain = stoi(word_list[2]) * 99 / 100;
+        total_remaining = myremain;
     }
     else if (word_list[1] == "depth") {
         moves_to_go = 1;
         myremain = 3600000;
         think_depth_limit = stoi(word_list[2]);
     }
+    else if (word_list[1] == "nodes") {
+        moves_to_go = 1;
+        myremain = total_remaining = 3600000;
+        think_node_limit = stoull(word_list[2]);
+    }
+    else if (word_list[1] == "mate") {
+        moves_to_go = 1;
+        myremain = total_remaining = 3600000;
+        think_mate_limit = stoi(word_list[2]);
+    }
     else if (word_list.size() > 1) {
         for (unsigned i = 1 ; i < word_list.size() ; i += 2) {
             if (word_list[i] == "wtime")
@@ -97,6 +128,10 @@ inline void init_time(Position *p, std::vector<std::string> word_list) {
                 myremain = 3600000;
             if (word_list[i] == "depth")
                 think_depth_limit = stoi(word_list[i + 1]);
+            if (word_list[i] == "nodes")
+                think_node_limit = stoull(word_list[i + 1]);
+            if (word_list[i] == "mate")
+                think_mate_limit = stoi(word_list[i + 1]);
         }
 
         TTime t = get_myremain(
@@ -106,13 +141,34 @@ inline void init_time(Position *p, std::vector<std::string> word_list) {
         );
         myremain = t.optimum_time;
         total_remaining = t.maximum_time;
+        clock_search = (p->color == white ? white_remaining : black_remaining) > 0 &&
+                       std::find(word_list.begin(), word_list.end(), "infinite") == word_list.end() &&
+                       think_depth_limit == MAX_PLY && !think_node_limit && !think_mate_limit;
     }
 }
 
 int alpha_beta_quiescence(Position *p, Metadata *md, int alpha, int beta, int depth, bool in_check);
 void think(Position *p, std::vector<std::string> word_list);
-void print_pv();
+void init_pool();
+void destroy_pool();
+// Runs job(worker, workers) on every worker of the search pool, pinned when ThreadBinding
+// is on, and returns once all of them are done. Without a pool the caller runs job(0, 1)
+void run_on_pool(std::function<void(int, int)> job);
+void start_thinking(Position *p, std::vector<std::string> word_list);
+void wait_for_search();
+void print_pv(PV *line);
 void bench();
+void smp_bench(int depth);
+
+// The game the UCI thread keeps on thread 0, which benches import their positions over
+typedef struct GameState {
+    std::vector<Position> positions;
+    int root_ply;
+    int search_ply;
+} GameState;
+
+GameState save_game_state();
+void restore_game_state(GameState &state);
 
 // Taken from Ethereal
 const std::string benchmarks[36] = {
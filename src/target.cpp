@@ -21,13 +21,21 @@
 #include "magic.h"
 
 Bitboard generate_rook_targets(Bitboard board, Square index) {
+#ifdef __PEXT__
+    return rook_pext_slices[index][_pext_u64(board, rookMagic[index].mask)];
+#else
     int magic = ((rookMagic[index].mask & board) * rookMagic[index].magic) >> 52;
     return rook_magic_moves[index][magic];
+#endif
 }
 
 Bitboard generate_bishop_targets(Bitboard board, Square index) {
+#ifdef __PEXT__
+    return bishop_pext_slices[index][_pext_u64(board, bishopMagic[index].mask)];
+#else
     int magic = ((bishopMagic[index].mask & board) * bishopMagic[index].magic) >> 55;
     return bishop_magic_moves[index][magic];
+#endif
 }
 
 Bitboard generate_knight_targets(Square index) {
@@ -69,6 +69,124 @@ void see_test() {
     std::cout << "Success!" << std::endl;
 }
 
+bool tt_test() {
+    const int num_writers = 8;
+    const int iterations = 1000000;
+
+    clear_tt();
+    std::atomic<uint64_t> hits(0), misses(0), torn(0), corrupt(0);
+    std::vector<std::thread> writers;
+
+    // Every thread owns one key and all keys land in bucket 0, so each write
+    // races with the other threads' reads and writes of the same three slots
+    for (int t = 0; t < num_writers; ++t) {
+        writers.push_back(std::thread([&, t]() {
+            uint16_t my_key = uint16_t(t + 1);
+            for (int i = 0; i < iterations; ++i) {
+                bool tt_hit;
+                TTEntry entry;
+                int depth = i % 64;
+                TTEntry *slot = get_tte(uint64_t(my_key) << 48, entry, tt_hit);
+                set_tte(uint64_t(my_key) << 48, slot, Move(my_key), depth, my_key * 7 + depth, -my_key * 3, FLAG_EXACT);
+
+                uint16_t other_key = uint16_t((t + i) % num_writers + 1);
+                get_tte(uint64_t(other_key) << 48, entry, tt_hit);
+                if (tt_hit) {
+                    ++hits;
+                    if (entry.move != other_key || entry.score != other_key * 7 + entry.depth || entry.static_eval != -other_key * 3) {
+                        ++corrupt;
+                    }
+                } else {
+                    ++misses;
+                }
+
+                for (int j = 0; j < bucket_size; ++j) {
+                    TTEntry raw = tte_read(&table.tt[0].ttes[j]);
+                    uint16_t key = tte_key(&raw);
+                    if (key > num_writers) {
+                        ++torn;
+                    }
+                }
+            }
+        }));
+    }
+    for (std::thread &writer : writers) {
+        writer.join();
+    }
+    clear_tt();
+
+    std::cout << "Probes: " << hits + misses << " hits: " << hits << " misses: " << misses << std::endl;
+    std::cout << "Torn entries detected: " << torn << std::endl;
+    std::cout << "Corrupt hits: " << corrupt << std::endl;
+
+    // A torn copy decodes to an effectively random 16 bit key, so it is taken for
+    // the probed key once in 65536 reads. Allow that rate plus three standard
+    // deviations; with no torn entries no corrupt hit is allowed at all.
+    double expected = double(torn) / 65536;
+    uint64_t allowed = uint64_t(expected + 3 * std::sqrt(expected));
+    if (corrupt > allowed) {
+        std::cout << "Failed: " << corrupt << " corrupt hits, at most " << allowed << " allowed" << std::endl;
+        return false;
+    }
+    std::cout << "Success!" << std::endl;
+    return true;
+}
+
+bool slider_bench() {
+#ifdef __PEXT__
+    std::cout << "Sliders: pext, ";
+#else
+    std::cout << "Sliders: magic, ";
+#endif
+    std::cout << slider_table_size() / 1024 << " KB of tables" << std::endl;
+
+    // Occupancies of the bench positions, checked against the slow attack generators first.
+    // import_fen writes over thread 0's game, which is put back once the boards are read
+    GameState game = save_game_state();
+    Bitboard boards[36];
+    for (int i = 0; i < 36; ++i) {
+        boards[i] = import_fen(benchmarks[i], 0)->board;
+    }
+    restore_game_state(game);
+
+    for (int i = 0; i < 36; ++i) {
+        for (Square sq = A1; sq <= H8; ++sq) {
+            Bitboard rook = generate_rook_targets(boards[i], sq);
+            Bitboard bishop = generate_bishop_targets(boards[i], sq);
+            if (rook != create_rook_attacks(sq, boards[i]) || bishop != create_bishop_attacks(sq, boards[i])) {
+                std::cout << "Failed: position " << i << " square " << int(sq) << std::hex
+                          << " occupancy 0x" << boards[i]
+                          << " rook 0x" << rook << " expected 0x" << create_rook_attacks(sq, boards[i])
+                          << " bishop 0x" << bishop << " expected 0x" << create_bishop_attacks(sq, boards[i])
+                          << std::dec << std::endl;
+                return false;
+            }
+        }
+    }
+
+    const int rounds = 20000;
+    Bitboard sum = 0;
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < 36; ++i) {
+            for (Square sq = A1; sq <= H8; ++sq) {
+                sum += generate_rook_targets(boards[i], sq) ^ generate_bishop_targets(boards[i], sq);
+            }
+        }
+    }
+    gettimeofday(&end, NULL);
+
+    double seconds = (double) (end.tv_usec - start.tv_usec) / 1000000 + (double) (end.tv_sec - start.tv_sec);
+    uint64_t lookups = uint64_t(rounds) * 36 * 64 * 2;
+    std::cout << "Lookups            :  " << lookups << std::endl;
+    std::cout << "Lookups per second :  " << uint64_t(lookups / seconds) << std::endl;
+    std::cout << "ns per lookup      :  " << seconds * 1e9 / lookups << std::endl;
+    // Keeps the loop from being optimized away
+    std::cout << "Checksum           :  " << (sum & 0xFFFF) << std::endl;
+    return true;
+}
+
 void perft_test(){
     //? DONT FORGET : https://chessprogramming.wikispaces.com/Perft+Results
     printf("\nStarted testing !\n\n");
@@ -170,7 +288,7 @@ uint64_t fastPerft(int depth, Position *p, bool root, bool in_check) {
     const bool is_leaf = depth == 2;
 
     Metadata *md = &p->my_thread->metadatas[0];
-    MoveGen movegen = new_movegen(p, md, depth, no_move, NORMAL_SEARCH, in_check);
+    MoveGen movegen = new_movegen(p, md, depth, no_move, PERFT_SEARCH, in_check);
     Move move;
     while ((move = next_move(&movegen)) != no_move) {
         if (root && depth == 1) {
@@ -32,12 +32,16 @@
 #include "target.h"
 #include "magic.h"
 #include "see.h"
+#include "tt.h"
+#include <vector>
 
 #include "stdio.h"
 
 uint64_t Perft(int index, Position* p, bool root, bool in_check);
 
 void see_test();
+bool tt_test();
 void perft_test();
+bool slider_bench();
 
 #endif
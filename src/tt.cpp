@@ -21,42 +21,395 @@
 #include <cstring>
 #include <cstdlib>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
 #include "move_utils.h"
+#include "search.h"
+#include <sys/time.h>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+// Reads a sysfs list such as "0-3,8,10-11", empty if the file is not there
+std::vector<int> read_id_list(std::string path) {
+    std::ifstream f(path);
+    std::string line;
+    std::vector<int> ids;
+    if (!f || !std::getline(f, line)) {
+        return ids;
+    }
+    std::stringstream ranges(line);
+    std::string range;
+    while (std::getline(ranges, range, ',')) {
+        size_t dash = range.find('-');
+        int lo = std::stoi(range.substr(0, dash));
+        int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+        for (int n = lo; n <= hi; ++n) {
+            ids.push_back(n);
+        }
+    }
+    return ids;
+}
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE 3
+#endif
+#endif
 
 Table table;
-PawnTTEntry *pawntt;
+int pawntt_megabytes = 1;
+int eval_cache_megabytes = 4;
 
-const uint64_t one_mb = 1024ULL * 1024ULL;
+bool large_pages = true;
+int numa_policy = NUMA_FIRST_TOUCH;
+std::string shared_hash_name = "";
 
-const uint64_t pawntt_size = one_mb * 1ULL; // 1 MB
-const uint64_t pawntt_mod = (uint64_t)(pawntt_size / sizeof(PawnTTEntry));
+TTFileHeader *shared_header = nullptr;
+bool shared_created = false;
+// The segment this process created and its size, unlinked once it is not asked for anymore
+std::string created_shared_name = "";
+uint64_t created_shared_total = 0;
 
-void init_tt() {
-    table.tt_size = one_mb * 16ULL; // 16 MB
-    table.tt = (Bucket*) malloc(table.tt_size);
-    table.bucket_mask = (uint64_t)(table.tt_size / sizeof(Bucket) - 1);
+const uint64_t two_mb = 2ULL * one_mb;
+const uint64_t one_gb = 1024ULL * one_mb;
+
+inline uint64_t round_up(uint64_t size, uint64_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+// Buckets never straddle cache lines as long as the array is aligned to the bucket size
+void *aligned_block(uint64_t size) {
+#if defined(_WIN32)
+    return _aligned_malloc(size, bucket_bytes);
+#else
+    void *mem = nullptr;
+    return posix_memalign(&mem, bucket_bytes, size) == 0 ? mem : nullptr;
+#endif
+}
+
+void free_aligned_block(void *mem) {
+#if defined(_WIN32)
+    _aligned_free(mem);
+#else
+    free(mem);
+#endif
+}
+
+void free_tt() {
+    if (!table.tt) {
+        return;
+    }
+#if defined(__linux__)
+    if (table.alloc_type == ALLOC_HUGETLB_1GB || table.alloc_type == ALLOC_HUGETLB_2MB) {
+        munmap(table.tt, table.alloc_size);
+    } else if (table.alloc_type == ALLOC_FILE || table.alloc_type == ALLOC_SHARED) {
+        munmap((char*) table.tt - sizeof(TTFileHeader), table.alloc_size);
+        shared_header = nullptr;
+    } else {
+        free(table.tt);
+    }
+#else
+    free_aligned_block(table.tt);
+#endif
+    table.tt = nullptr;
+    table.alloc_size = 0;
+}
+
+#if defined(__linux__)
+// Reads /sys/devices/system/node/online ("0", "0-1", "0,2-3", ...) into a node mask
+uint64_t online_numa_nodes() {
+    uint64_t mask = 0;
+    for (int node : read_id_list("/sys/devices/system/node/online")) {
+        if (node < 64) {
+            mask |= 1ULL << node;
+        }
+    }
+    return mask ? mask : 1;
+}
+
+void *map_huge(uint64_t size, int flags) {
+    void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | flags, -1, 0);
+    return mem == MAP_FAILED ? nullptr : mem;
+}
+#endif
+
+#if defined(__linux__)
+std::string shared_segment_name() {
+    if (shared_hash_name.empty()) {
+        return "";
+    }
+    return shared_hash_name[0] == '/' ? shared_hash_name : "/" + shared_hash_name;
+}
+
+// Processes still attached to an unlinked segment keep using it until they resize
+void unlink_shared_tt(std::string keep_name, uint64_t keep_total) {
+    if (!created_shared_name.empty() && (created_shared_name != keep_name || created_shared_total != keep_total)) {
+        shm_unlink(created_shared_name.c_str());
+        created_shared_name = "";
+        created_shared_total = 0;
+    }
+}
+
+// Creates or attaches to the POSIX shared memory segment named by HashShared. The
+// segment starts with the same header as saved tables, and the creator publishes the
+// magic last so processes that attach concurrently wait for a sized, valid segment.
+bool attach_shared_tt(uint64_t size) {
+    std::string name = shared_segment_name();
+    uint64_t total = sizeof(TTFileHeader) + size;
+
+    bool fresh = true;
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1 && errno == EEXIST) {
+        fresh = false;
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    if (fd == -1) {
+        return false;
+    }
+
+    if (fresh) {
+        if (ftruncate(fd, off_t(total)) != 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+    } else {
+        struct stat st;
+        st.st_size = 0;
+        for (int i = 0; i < 1000 && (fstat(fd, &st) != 0 || uint64_t(st.st_size) <= sizeof(TTFileHeader)); ++i) {
+            usleep(1000);
+        }
+        total = uint64_t(st.st_size);
+    }
+
+    void *mem = total > sizeof(TTFileHeader) ? mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mem == MAP_FAILED) {
+        if (fresh) {
+            shm_unlink(name.c_str());
+        }
+        return false;
+    }
+
+    TTFileHeader *header = (TTFileHeader*) mem;
+    if (fresh) {
+        // A fresh segment is zero filled, which is an empty table
+        header->version = tt_file_version;
+        header->bucket_bytes = sizeof(Bucket);
+        header->tt_size = size;
+        header->generation = 0;
+        __sync_synchronize();
+        std::memcpy(header->magic, tt_file_magic, sizeof(header->magic));
+        created_shared_name = name;
+        created_shared_total = total;
+    } else {
+        for (int i = 0; i < 1000 && std::memcmp(header->magic, tt_file_magic, sizeof(header->magic)) != 0; ++i) {
+            usleep(1000);
+        }
+        __sync_synchronize();
+        if (std::memcmp(header->magic, tt_file_magic, sizeof(header->magic)) != 0 ||
+            header->version != tt_file_version ||
+            header->bucket_bytes != sizeof(Bucket) ||
+            header->tt_size + sizeof(TTFileHeader) != total) {
+                munmap(mem, total);
+                return false;
+        }
+        if (header->tt_size != size) {
+            std::cout << "info string Shared hash " << shared_hash_name << " already has " << header->tt_size / one_mb
+                      << " MB, using it instead of " << size / one_mb << " MB" << std::endl;
+        }
+    }
+
+    shared_header = header;
+    shared_created = created_shared_name == name;
+    table.tt = (Bucket*) ((char*) mem + sizeof(TTFileHeader));
+    table.tt_size = header->tt_size;
+    table.alloc_size = total;
+    table.alloc_type = ALLOC_SHARED;
+    table.generation = header->generation % 64;
+    return true;
+}
+#endif
+
+void allocate_tt(uint64_t size) {
+    free_tt();
+
+    table.tt_size = size;
+    table.numa_nodes = 1;
+    table.numa_interleaved = false;
+#if defined(__linux__)
+    table.tt = nullptr;
+    // A segment this process created with another name or size is made again below
+    unlink_shared_tt(shared_segment_name(), sizeof(TTFileHeader) + size);
+    if (!shared_hash_name.empty()) {
+        if (attach_shared_tt(size)) {
+            table.bucket_count = table.tt_size / sizeof(Bucket);
+            return;
+        }
+        std::cout << "info string Could not attach shared hash " << shared_hash_name << ", using private memory" << std::endl;
+    }
+    if (large_pages && size >= one_gb) {
+        table.alloc_size = round_up(size, one_gb);
+        table.tt = (Bucket*) map_huge(table.alloc_size, MAP_HUGE_1GB);
+        table.alloc_type = ALLOC_HUGETLB_1GB;
+    }
+    if (!table.tt && large_pages) {
+        table.alloc_size = round_up(size, two_mb);
+        table.tt = (Bucket*) map_huge(table.alloc_size, 0);
+        table.alloc_type = ALLOC_HUGETLB_2MB;
+    }
+    if (!table.tt) {
+        // No reserved huge pages, ask for transparent ones on a 2 MB aligned block
+        table.alloc_size = round_up(size, two_mb);
+        void *mem = nullptr;
+        if (posix_memalign(&mem, two_mb, table.alloc_size) != 0) {
+            std::cout << "info string Failed to allocate " << size / one_mb << " MB for hash" << std::endl;
+            // Joinable workers would make exit abort instead
+            destroy_pool();
+            exit(EXIT_FAILURE);
+        }
+        table.tt = (Bucket*) mem;
+        table.alloc_type = ALLOC_ALIGNED;
+        if (large_pages && madvise(mem, table.alloc_size, MADV_HUGEPAGE) == 0) {
+            table.alloc_type = ALLOC_TRANSPARENT;
+        }
+    }
+
+    uint64_t nodes = online_numa_nodes();
+    table.numa_nodes = __builtin_popcountll(nodes);
+    if (numa_policy == NUMA_INTERLEAVE && table.numa_nodes > 1) {
+        // Must happen before the first touch below, otherwise the pages are already placed
+        table.numa_interleaved = syscall(SYS_mbind, table.tt, table.alloc_size, MPOL_INTERLEAVE, &nodes, 64, 0) == 0;
+    }
+#else
+    if (!shared_hash_name.empty()) {
+        std::cout << "info string Shared hash is not supported on this platform" << std::endl;
+    }
+    table.alloc_size = size;
+    table.tt = (Bucket*) aligned_block(size);
+    table.alloc_type = ALLOC_MALLOC;
+    if (!table.tt) {
+        std::cout << "info string Failed to allocate " << size / one_mb << " MB for hash" << std::endl;
+        destroy_pool();
+        exit(EXIT_FAILURE);
+    }
+#endif
+    table.bucket_count = table.tt_size / sizeof(Bucket);
     table.generation = 0;
-    std::memset(table.tt, 0, table.tt_size);
 
-    pawntt = (PawnTTEntry*) malloc(pawntt_size);
-    std::memset(pawntt, 0, pawntt_size);
+    // Never hand out recycled memory as entries, zero the whole new table. Unless the
+    // placement is left alone, the search workers touch their own slices of it first
+    if (numa_policy == NUMA_OFF) {
+        std::memset(table.tt, 0, table.tt_size);
+    } else {
+        parallel_memset(table.tt, table.tt_size);
+    }
+}
+
+void parallel_memset(void *mem, uint64_t size) {
+    // One slice per search worker. Besides being faster on large tables, pages that were
+    // not touched yet get placed on the nodes of the workers that search with them
+    run_on_pool([mem, size](int i, int n) {
+        uint64_t chunk = size / n;
+        uint64_t len = i == n - 1 ? size - chunk * i : chunk;
+        std::memset((char*) mem + chunk * i, 0, len);
+    });
+}
+
+void print_tt_allocation(int time_taken) {
+    if (table.alloc_type == ALLOC_SHARED) {
+        std::cout << "info string Hash " << table.tt_size / one_mb << " MB in shared memory " << shared_hash_name
+                  << (shared_created ? " (created)" : " (attached)") << std::endl;
+        return;
+    }
+
+    const char *pages[] = {"normal pages", "normal pages", "transparent huge pages", "2MB huge pages", "1GB huge pages", "a file mapping"};
+    std::cout << "info string Hash " << table.tt_size / one_mb << " MB with " << pages[table.alloc_type];
+    if (large_pages && table.alloc_type < ALLOC_TRANSPARENT) {
+        std::cout << " (huge pages unavailable)";
+    }
+    std::cout << ", " << table.numa_nodes << " numa node" << (table.numa_nodes > 1 ? "s" : "");
+    if (table.numa_nodes > 1) {
+        if (numa_policy == NUMA_INTERLEAVE) {
+            std::cout << (table.numa_interleaved ? " interleaved" : " (interleave failed)");
+        } else if (numa_policy == NUMA_FIRST_TOUCH) {
+            std::cout << " first touched by " << num_threads << " threads";
+        }
+    }
+    std::cout << ", cleared in " << time_taken << " ms" << std::endl;
+}
+
+void release_shared_tt() {
+#if defined(__linux__)
+    unlink_shared_tt("", 0);
+#endif
+}
+
+void init_tt() {
+    table.tt = nullptr;
+    allocate_tt(one_mb * 16ULL); // 16 MB
     // std::cout << sizeof(Bucket) << std::endl;
 }
 
 void reset_tt(int megabytes) {
-    table.tt_size = one_mb * (uint64_t) (megabytes);
-    table.tt = (Bucket*) realloc(table.tt, table.tt_size);
-    table.bucket_mask = (uint64_t)(table.tt_size / sizeof(Bucket) - 1);
+    struct timeval start, end;
+    gettimeofday(&start, nullptr);
+    allocate_tt(one_mb * (uint64_t) (megabytes));
+    gettimeofday(&end, nullptr);
+    print_tt_allocation(bench_time(start, end));
 }
 
-void clear_tt() {
-    std::memset(table.tt, 0, table.tt_size);
-    std::memset(pawntt, 0, pawntt_size);
-    table.generation = 0;
+// The pages of a first touch table stay where the old workers touched them, so after the
+// pool changes a table spread over several nodes is allocated and touched again
+void retouch_tt() {
+    if (numa_policy == NUMA_FIRST_TOUCH && table.numa_nodes > 1 && table.alloc_type != ALLOC_SHARED) {
+        reset_tt(hash_megabytes());
+    }
+}
+
+int clear_tt() {
+    struct timeval start, end;
+    gettimeofday(&start, nullptr);
+    for (int i = 0; i < num_threads; ++i) {
+        SearchThread *t = search_threads[i];
+        std::memset(t->pawntt, 0, (t->pawntt_mask + 1) * sizeof(PawnTTEntry));
+        std::memset(t->eval_cache, 0, (t->eval_cache_mask + 1) * sizeof(EvalCacheEntry));
+        // The continuation and capture histories carry over from move to move within a game
+        std::memset(t->counter_history, 0, sizeof(t->counter_history));
+        std::memset(t->followup_history, 0, sizeof(t->followup_history));
+        std::memset(t->capture_history, 0, sizeof(t->capture_history));
+    }
+    // Other processes keep searching with a shared table, leave it and its generation alone
+    if (table.alloc_type != ALLOC_SHARED) {
+        parallel_memset(table.tt, table.tt_size);
+        table.generation = 0;
+    }
+    gettimeofday(&end, nullptr);
+    return bench_time(start, end);
 }
 
 void start_search() {
-    table.generation = (table.generation + 1) % 64;
+    if (shared_header) {
+        table.generation = __sync_add_and_fetch(&shared_header->generation, 1) % 64;
+    } else {
+        table.generation = (table.generation + 1) % 64;
+    }
 }
 
 int score_to_tt(int score, uint16_t ply) {
@@ -79,12 +432,111 @@ int tt_to_score(int score, uint16_t ply) {
     }
 }
 
+bool save_tt(std::string path) {
+    TTFileHeader header = {};
+    std::memcpy(header.magic, tt_file_magic, sizeof(header.magic));
+    header.version = tt_file_version;
+    header.bucket_bytes = sizeof(Bucket);
+    header.tt_size = table.tt_size;
+    header.generation = table.generation;
+
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    f.write((const char*) &header, sizeof(header));
+    f.write((const char*) table.tt, std::streamsize(table.tt_size));
+    if (!f) {
+        std::cout << "info string Could not save hash to " << path << std::endl;
+        return false;
+    }
+    std::cout << "info string Saved " << table.tt_size / one_mb << " MB of hash to " << path << std::endl;
+    return true;
+}
+
+bool load_tt(std::string path) {
+    TTFileHeader header;
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    uint64_t file_size = f ? uint64_t(f.tellg()) : 0;
+    f.seekg(0);
+    if (!f || file_size < sizeof(header) || !f.read((char*) &header, sizeof(header))) {
+        std::cout << "info string Could not read hash file " << path << std::endl;
+        return false;
+    }
+    if (std::memcmp(header.magic, tt_file_magic, sizeof(header.magic)) != 0 ||
+        header.version != tt_file_version ||
+        header.bucket_bytes != sizeof(Bucket) ||
+        header.tt_size == 0 || header.tt_size % sizeof(Bucket) != 0 ||
+        file_size != sizeof(header) + header.tt_size) {
+            std::cout << "info string Incompatible hash file " << path << std::endl;
+            return false;
+    }
+
+#if defined(__linux__)
+    // Map it copy-on-write: searching never modifies the file, and processes that
+    // load the same file share the page cache until they write to an entry
+    int fd = open(path.c_str(), O_RDONLY);
+    void *mem = fd == -1 ? MAP_FAILED : mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (fd != -1) {
+        close(fd);
+    }
+    if (mem == MAP_FAILED) {
+        std::cout << "info string Could not map hash file " << path << std::endl;
+        return false;
+    }
+    free_tt();
+    table.tt = (Bucket*) ((char*) mem + sizeof(header));
+    table.alloc_size = file_size;
+    table.alloc_type = ALLOC_FILE;
+#else
+    Bucket *buckets = (Bucket*) aligned_block(header.tt_size);
+    if (!buckets || !f.read((char*) buckets, std::streamsize(header.tt_size))) {
+        free_aligned_block(buckets);
+        std::cout << "info string Could not read hash file " << path << std::endl;
+        return false;
+    }
+    free_tt();
+    table.tt = buckets;
+    table.alloc_size = header.tt_size;
+    table.alloc_type = ALLOC_MALLOC;
+#endif
+    table.tt_size = header.tt_size;
+    table.bucket_count = table.tt_size / sizeof(Bucket);
+    table.generation = header.generation;
+    table.numa_nodes = 1;
+    table.numa_interleaved = false;
+
+    std::cout << "info string Loaded " << table.tt_size / one_mb << " MB of hash from " << path << ", generation " << int(table.generation) << std::endl;
+    return true;
+}
+
+void print_tt_stats() {
+#ifdef __TTSTATS__
+    TTStats s = sum_tt_stats();
+    uint64_t stores = 0;
+    for (int i = 0; i < STORE_TYPES; ++i) {
+        stores += s.stores[i];
+    }
+    std::cout << "info string tt probes " << s.probes << " hits " << s.hits
+              << " hitrate " << (s.probes ? s.hits * 1000 / s.probes : 0) << " permill"
+              << " collisions " << s.collisions
+              << " cutoffs exact " << s.cutoffs[FLAG_EXACT] << " beta " << s.cutoffs[FLAG_BETA] << " alpha " << s.cutoffs[FLAG_ALPHA] << std::endl;
+    std::cout << "info string tt stores " << stores << " empty " << s.stores[STORE_EMPTY]
+              << " update " << s.stores[STORE_UPDATE] << " kept " << s.stores[STORE_MOVE_ONLY]
+              << " replaced_age " << s.stores[STORE_REPLACE_AGE] << " replaced_depth " << s.stores[STORE_REPLACE_DEPTH] << std::endl;
+#else
+    std::cout << "info string tt stats are not compiled in, build with make ttstats" << std::endl;
+#endif
+}
+
+int hash_megabytes() {
+    return int(table.tt_size / one_mb);
+}
+
 int hashfull() {
     int count = 0;
-    for (uint64_t i = 0; i < table.bucket_mask; i += uint64_t(table.bucket_mask / 1000)) {
-        Bucket *bucket = &table.tt[i];
+    for (uint64_t i = 0; i < 1000; ++i) {
+        Bucket *bucket = &table.tt[i * table.bucket_count / 1000];
         for (int j = 0; j < bucket_size; ++j) {
-            if (bucket->ttes[j].hash) {
+            TTEntry entry = tte_read(&bucket->ttes[j]);
+            if (tte_key(&entry)) {
                 ++count;
             }
         }
@@ -92,80 +544,144 @@ int hashfull() {
     return count / bucket_size;
 }
 
-int age_diff(TTEntry *tte) {
-    return (table.generation - tte_age(tte)) & 0x3F;
+// With a shared table every process bumps the header's generation, so ages are
+// taken from there. A cached table.generation would make the entries of a
+// process that searched more recently look up to 63 generations old.
+inline uint8_t current_generation() {
+    if (shared_header) {
+        return __atomic_load_n(&shared_header->generation, __ATOMIC_RELAXED) % 64;
+    }
+    return table.generation;
+}
+
+int age_diff(TTEntry *tte, uint8_t generation) {
+    return (generation - tte_age(tte)) & 0x3F;
 }
 
-void set_tte(uint64_t hash, TTEntry *tte, Move move, int depth, int score, int static_eval, uint8_t flag) {
+TTStoreType set_tte(uint64_t hash, TTEntry *tte, Move move, int depth, int score, int static_eval, uint8_t flag) {
 #ifndef __TUNE__
     uint16_t h = (uint16_t)(hash >> 48);
 
-    if (move || h != tte->hash) {
-        tte->move = move;
+    // Work on a private copy and publish it with a single store
+    TTEntry entry = tte_read(tte);
+    uint16_t key = tte_key(&entry);
+    uint8_t generation = current_generation();
+    TTStoreType store_type = h == key ? (depth > entry.depth - 4 ? STORE_UPDATE : STORE_MOVE_ONLY)
+                           : !key ? STORE_EMPTY
+                           : tte_age(&entry) != generation ? STORE_REPLACE_AGE : STORE_REPLACE_DEPTH;
+
+    if (move || h != key) {
+        entry.move = move;
     }
 
-    if (h != tte->hash || depth > tte->depth - 4) {
+    if (h != key || depth > entry.depth - 4) {
         assert(depth < 256 && depth > -256);
-        tte->hash = h;
-        tte->depth = (int8_t)depth;
-        tte->score = (int16_t)score;
-        tte->static_eval = (int16_t)static_eval;
-        tte->ageflag = (table.generation << 2) | flag;
+        entry.depth = (int8_t)depth;
+        entry.score = (int16_t)score;
+        entry.static_eval = (int16_t)static_eval;
+        entry.ageflag = (generation << 2) | flag;
     }
+
+    entry.hash = h ^ tte_checksum(&entry);
+    tte_write(tte, entry);
+    return store_type;
+#else
+    return STORE_EMPTY;
 #endif
 }
 
-TTEntry *get_tte(uint64_t hash, bool &tt_hit) {
+TTEntry *get_tte(uint64_t hash, TTEntry &entry, bool &tt_hit) {
 #ifndef __TUNE__
-    uint64_t index = hash & table.bucket_mask;
-    Bucket *bucket = &table.tt[index];
+    Bucket *bucket = &table.tt[tt_index(hash)];
 
     uint16_t h = (uint16_t)(hash >> 48);
+    TTEntry entries[bucket_size];
     for (int i = 0; i < bucket_size; ++i) {
-        if (!bucket->ttes[i].hash) {
+        entries[i] = tte_read(&bucket->ttes[i]);
+        uint16_t key = tte_key(&entries[i]);
+        if (!key) {
             tt_hit = false;
+            entry = entries[i];
             return &bucket->ttes[i];
         }
-        if (bucket->ttes[i].hash == h) {
+        if (key == h) {
             tt_hit = true;
+            entry = entries[i];
+            entry.hash = key;
             return &bucket->ttes[i];
         }
     }
 
-    TTEntry *replacement = &bucket->ttes[0];
+    uint8_t generation = current_generation();
+    int replacement = 0;
     for (int i = 1; i < bucket_size; ++i) {
-        if (bucket->ttes[i].depth - age_diff(&bucket->ttes[i]) * 16 < replacement->depth - age_diff(replacement) * 16) {
-            replacement = &bucket->ttes[i];
+        if (entries[i].depth - age_diff(&entries[i], generation) * 16 < entries[replacement].depth - age_diff(&entries[replacement], generation) * 16) {
+            replacement = i;
         }
     }
 
     tt_hit = false;
-    return replacement;
+    entry = entries[replacement];
+    return &bucket->ttes[replacement];
 #else
     Bucket *bucket = &table.tt[0];
     tt_hit = false;
+    entry = tte_read(&bucket->ttes[0]);
     return &bucket->ttes[0];
 #endif
 }
 
-void set_pawntte(uint64_t pawn_hash, Evaluation* eval) {
-#ifndef __TUNE__
-    uint64_t index = pawn_hash % pawntt_mod;
-    PawnTTEntry *pawntte = &pawntt[index];
-    pawntte->pawn_hash = (uint32_t)(pawn_hash >> 32);
+template <typename Entry>
+void resize_thread_table(Entry *&entries, uint64_t &mask, bool wanted, int megabytes) {
+    // Round down to a power of two entries so the index is a mask
+    uint64_t size = 1;
+    while (size * 2 * sizeof(Entry) <= one_mb * (uint64_t) megabytes) {
+        size *= 2;
+    }
+
+    if (entries && (!wanted || mask != size - 1)) {
+        free(entries);
+        entries = nullptr;
+        mask = 0;
+    }
+    if (wanted && !entries) {
+        entries = (Entry*) calloc(size, sizeof(Entry));
+        mask = size - 1;
+    }
+}
+
+void allocate_thread_tables(SearchThread *t) {
+    resize_thread_table(t->pawntt, t->pawntt_mask, true, pawntt_megabytes);
+    resize_thread_table(t->eval_cache, t->eval_cache_mask, true, eval_cache_megabytes);
+}
+
+void allocate_thread_tables() {
+    for (int i = 0; i < num_threads; ++i) {
+        allocate_thread_tables(search_threads[i]);
+    }
+}
+
+// Positions without pawns have a zero pawn hash, which must not match an empty entry
+inline uint32_t pawntt_key(uint64_t pawn_hash) {
+    return (uint32_t)(pawn_hash >> 32) ^ 0x9E3779B9;
+}
+
+PawnTTEntry *set_pawntte(Position *p, Evaluation* eval) {
+    // Tuning still needs an entry to read the king shelters from, it just never hits
+    PawnTTEntry *pawntte = &p->my_thread->pawntt[p->pawn_hash & p->my_thread->pawntt_mask];
+    pawntte->pawn_hash = pawntt_key(p->pawn_hash);
     pawntte->score = eval->score_pawn;
     pawntte->pawn_passers[white] = eval->pawn_passers[white];
     pawntte->pawn_passers[black] = eval->pawn_passers[black];
     pawntte->semi_open_files[white] = eval->semi_open_files[white];
     pawntte->semi_open_files[black] = eval->semi_open_files[black];
-#endif
+    return pawntte;
 }
 
-PawnTTEntry *get_pawntte(uint64_t pawn_hash) {
+PawnTTEntry *get_pawntte(Position *p) {
 #ifndef __TUNE__
-    uint64_t index = pawn_hash % pawntt_mod;
-    PawnTTEntry *pawntte = &pawntt[index];
-    if (pawntte->pawn_hash == (uint32_t)(pawn_hash >> 32)) {
+    PawnTTEntry *pawntte = &p->my_thread->pawntt[p->pawn_hash & p->my_thread->pawntt_mask];
+    if (pawntte->pawn_hash == pawntt_key(p->pawn_hash)) {
         return pawntte;
     }
 #endif
@@ -20,13 +20,55 @@
 #define TT_H
 
 #include "data.h"
+#include <cstring>
+#include <string>
+#include <vector>
 
 void init_tt();
-void clear_tt();
+int clear_tt();
 void reset_tt(int megabytes);
-
+void retouch_tt();
+// Unlinks the shared hash segment if this process created it, on quit
+void release_shared_tt();
+void print_tt_allocation(int time_taken);
+void parallel_memset(void *mem, uint64_t size);
+
+enum AllocType {
+    ALLOC_MALLOC,
+    ALLOC_ALIGNED,
+    ALLOC_TRANSPARENT,
+    ALLOC_HUGETLB_2MB,
+    ALLOC_HUGETLB_1GB,
+    ALLOC_FILE,
+    ALLOC_SHARED
+};
+
+enum NumaPolicy {
+    NUMA_OFF,
+    NUMA_FIRST_TOUCH,
+    NUMA_INTERLEAVE
+};
+
+extern bool large_pages;
+extern int numa_policy;
+std::vector<int> read_id_list(std::string path);
+extern std::string shared_hash_name;
+
+const uint64_t one_mb = 1024ULL * 1024ULL;
+
+// Build with -D__BUCKET64__ (make BUCKET=64) for cache line sized buckets
+#ifdef __BUCKET64__
+const int bucket_size = 6;
+const int bucket_bytes = 64;
+#else
 const int bucket_size = 3;
+const int bucket_bytes = 32;
+#endif
 
+// Entries are written without locks by all search threads. The stored hash is the
+// key xored with a hash of the data (see tte_key), so a reader that copied an
+// entry while another thread was halfway through writing it sees a key mismatch
+// instead of a move or score that belongs to a different position.
 typedef struct TTEntry {
     uint16_t hash;
     Move     move;
@@ -36,25 +78,65 @@ typedef struct TTEntry {
     int8_t   depth;
 } TTEntry;
 
-typedef struct Bucket {
+typedef struct alignas(bucket_bytes) Bucket {
     TTEntry ttes[bucket_size];
-    char padding[2]; // Totaling 32 bytes
+    char padding[bucket_bytes - bucket_size * sizeof(TTEntry)];
 } Bucket;
 
+static_assert(sizeof(Bucket) == bucket_bytes, "Bucket must fill exactly bucket_bytes");
+
 typedef struct Table {
     Bucket *tt;
     uint8_t generation;
     uint64_t tt_size;
-    uint64_t bucket_mask;
+    uint64_t bucket_count;
+    uint64_t alloc_size;
+    uint8_t  alloc_type;
+    int      numa_nodes;
+    bool     numa_interleaved;
 } Table;
 
+extern Table table;
+
+// Maps the low 32 bits of the hash onto [0, bucket_count) with a multiply and shift,
+// so the table does not need a power of two size. The high 16 bits are the entry key.
+inline uint64_t tt_index(uint64_t hash) {
+    return ((hash & 0xFFFFFFFFULL) * table.bucket_count) >> 32;
+}
+
+// Saved tables start with this header, padded to keep the buckets cache line aligned
+const char tt_file_magic[8] = {'D', 'E', 'F', 'H', 'A', 'S', 'H', '\0'};
+const uint32_t tt_file_version = 1;
+
+typedef struct TTFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t bucket_bytes;
+    uint64_t tt_size;
+    uint8_t  generation;
+    char     padding[39]; // Totaling 64 bytes
+} TTFileHeader;
+
+bool save_tt(std::string path);
+bool load_tt(std::string path);
+
 typedef struct PawnTTEntry {
     uint32_t pawn_hash;
     Score    score;
     Bitboard pawn_passers[2];
     int      semi_open_files[2];
+    int16_t  king_shelter[2][8]; // Pawn shelter of a king on its first rank, by file
 } PawnTTEntry;
 
+typedef struct EvalCacheEntry {
+    uint32_t key;
+    int32_t  eval;
+} EvalCacheEntry;
+
+// Every search thread has its own pawn table and eval cache of this many megabytes
+extern int pawntt_megabytes;
+extern int eval_cache_megabytes;
+
 inline uint8_t tte_flag(TTEntry *tte) {
     return (uint8_t) (tte->ageflag & 0x3);
 }
@@ -63,17 +145,61 @@ inline uint8_t tte_age(TTEntry *tte) {
     return (uint8_t) (tte->ageflag >> 2);
 }
 
+inline uint16_t tte_checksum(TTEntry *tte) {
+    // Multiplicative, unlike a plain xor of the fields, so that halves of two
+    // different writes do not cancel each other out into a valid key
+    uint64_t data = uint64_t(tte->move) | uint64_t(uint16_t(tte->score)) << 16 | uint64_t(uint16_t(tte->static_eval)) << 32 |
+                    uint64_t(tte->ageflag) << 48 | uint64_t(uint8_t(tte->depth)) << 56;
+    return (uint16_t) ((data * 0x9E3779B97F4A7C15ULL) >> 48);
+}
+
+// Entries are shared without locks, so they are only ever copied in and out
+// whole. The barriers stop the compiler from going back to the slot for single
+// fields, which would mix two writes behind a checksum that was already verified
+inline TTEntry tte_read(const TTEntry *slot) {
+    TTEntry entry;
+    std::memcpy(&entry, slot, sizeof(TTEntry));
+    asm volatile("" ::: "memory");
+    return entry;
+}
+
+inline void tte_write(TTEntry *slot, const TTEntry &entry) {
+    asm volatile("" ::: "memory");
+    std::memcpy(slot, &entry, sizeof(TTEntry));
+}
+
+inline uint16_t tte_key(TTEntry *tte) {
+    return tte->hash ^ tte_checksum(tte);
+}
+
 int hashfull();
+void print_tt_stats();
+int hash_megabytes();
 void start_search();
-void set_tte(uint64_t hash, TTEntry *tte, Move m, int depth, int score, int static_eval, uint8_t flag);
-TTEntry *get_tte(uint64_t hash, bool &tt_hit);
+TTStoreType set_tte(uint64_t hash, TTEntry *tte, Move m, int depth, int score, int static_eval, uint8_t flag);
+TTEntry *get_tte(uint64_t hash, TTEntry &entry, bool &tt_hit);
+
+void allocate_thread_tables(SearchThread *t);
+void allocate_thread_tables();
+PawnTTEntry *set_pawntte(Position *p, Evaluation* eval);
+PawnTTEntry *get_pawntte(Position *p);
+
+// Called as soon as a child's hashes are known, so that the bucket it is going to
+// probe is on its way to the cache while the rest of the node is set up
+inline void prefetch_tt(uint64_t hash) {
+    __builtin_prefetch(&table.tt[tt_index(hash)]);
+}
 
-void set_pawntte(uint64_t pawn_hash, Evaluation* eval);
-PawnTTEntry *get_pawntte(uint64_t pawn_hash);
+inline void prefetch_pawntt(Position *p) {
+    __builtin_prefetch(&p->my_thread->pawntt[p->pawn_hash & p->my_thread->pawntt_mask]);
+}
+
+inline EvalCacheEntry *get_eval_cache(Position *p) {
+    return &p->my_thread->eval_cache[p->hash & p->my_thread->eval_cache_mask];
+}
 
 int score_to_tt(int score, uint16_t ply);
 int tt_to_score(int score, uint16_t ply);
 
-extern PawnTTEntry *pawntt;
 
 #endif
@@ -114,16 +114,15 @@ long double find_error(vector<Parameter> params) {
         Parameter *param = &params[i];
         set_parameter(param);
     }
+    std::thread threads[MAX_THREADS];
     for (int i = 0; i < num_threads; ++i) {
         diffs[i].clear();
-        SearchThread *t = &search_threads[i];
-        t->thread_obj = std::thread(single_error, i);
+        threads[i] = std::thread(single_error, i);
     }
 
     unsigned total_size = 0;
     for (int i = 0; i < num_threads; ++i) {
-        SearchThread *t = &search_threads[i];
-        t->thread_obj.join();
+        threads[i].join();
         total_size += diffs[i].size();
     }
     return kahansum() / ((long double) total_size);
@@ -79,8 +79,18 @@ void uci() {
     cout << "debug mode on" << std::endl;
 #endif
     cout << "option name Hash type spin default 256 min 1 max 16384" << endl;
+    cout << "option name LargePages type check default true" << endl;
+    cout << "option name HashNuma type combo default FirstTouch var Off var FirstTouch var Interleave" << endl;
+    cout << "option name HashShared type string default <empty>" << endl;
+    cout << "option name PawnHash type spin default 1 min 1 max 256" << endl;
+    cout << "option name EvalHash type spin default 4 min 1 max 256" << endl;
     cout << "option name Threads type spin default 1 min 1 max " << MAX_THREADS << endl;
+    cout << "option name ThreadBinding type combo default Off var Off var Spread var Compact" << endl;
+    cout << "option name DeferMoves type check default false" << endl;
+    cout << "option name MultiPV type spin default 1 min 1 max 256" << endl;
+    cout << "option name NodeTime type check default false" << endl;
     cout << "option name SyzygyPath type string default <empty>" << endl;
+    cout << "option name Ponder type check default false" << endl;
     cout << "option name MoveOverhead type spin default 100 min 0 max 5000" << endl;
     cout << "uciok" << endl;
 }
@@ -107,11 +117,19 @@ void debug() {
 
 void quit() {
     is_timeout = true;
+    destroy_pool();
+    release_shared_tt();
     exit(EXIT_SUCCESS);
 }
 
 void stop() {
     is_timeout = true;
+    // The position may only change once the search has let go of it
+    wait_for_search();
+}
+
+void ponderhit() {
+    is_pondering = false;
 }
 
 void generate() {
@@ -127,8 +145,7 @@ void eval() {
 }
 
 void go() {
-    std::thread think_thread (think, root_position, word_list);
-    think_thread.detach();
+    start_thinking(root_position, word_list);
 }
 
 void startpos() {
@@ -194,6 +211,21 @@ void see() {
     }
 }
 
+void cmd_tt() {
+    if (word_equal(1, "test")) {
+        if (!tt_test()) {
+            destroy_pool();
+            exit(EXIT_FAILURE);
+        }
+    } else if (word_equal(1, "save") && word_list.size() > 2) {
+        save_tt(word_list[2]);
+    } else if (word_equal(1, "load") && word_list.size() > 2) {
+        load_tt(word_list[2]);
+    } else if (word_equal(1, "stats")) {
+        print_tt_stats();
+    }
+}
+
 void cmd_position() {
     if (word_list[1] == "fen") 
         cmd_fen();
@@ -202,17 +234,59 @@ void cmd_position() {
     get_ready();
 }
 
+void print_thread_memory() {
+    uint64_t bytes = 0;
+    for (int i = 0; i < num_threads; ++i) {
+        SearchThread *t = search_threads[i];
+        bytes += sizeof(SearchThread) + (t->pawntt_mask + 1) * sizeof(PawnTTEntry) + (t->eval_cache_mask + 1) * sizeof(EvalCacheEntry);
+    }
+    cout << "info string " << num_threads << " search threads using " << bytes / one_mb << " MB, "
+         << sizeof(SearchThread) / 1024 << " KB of state each besides their tables" << endl;
+}
+
 void setoption() {
     if (word_list[1] != "name" || word_list[3] != "value") {
         return;
     }
     string name = word_list[2];
-    string value = word_list[4];
+    string value = word_list.size() > 4 ? word_list[4] : "";
 
     if (name == "Hash") {
         reset_tt(stoi(value));
+    } else if (name == "LargePages") {
+        large_pages = value == "true";
+        reset_tt(hash_megabytes());
+    } else if (name == "HashNuma") {
+        numa_policy = value == "Interleave" ? NUMA_INTERLEAVE : value == "FirstTouch" ? NUMA_FIRST_TOUCH : NUMA_OFF;
+        reset_tt(hash_megabytes());
+    } else if (name == "HashShared") {
+        shared_hash_name = value == "<empty>" ? "" : value;
+        reset_tt(hash_megabytes());
     } else if (name == "Threads") {
         num_threads = std::min(MAX_THREADS, stoi(value));
+        init_pool();
+        // New threads need the root position as well
+        get_ready();
+        print_thread_memory();
+        retouch_tt();
+    } else if (name == "ThreadBinding") {
+        thread_binding = value == "Spread" ? BIND_SPREAD : value == "Compact" ? BIND_COMPACT : BIND_OFF;
+        init_pool();
+        retouch_tt();
+    } else if (name == "NodeTime") {
+        node_time = value == "true";
+    } else if (name == "MultiPV") {
+        multi_pv = std::max(1, stoi(value));
+    } else if (name == "DeferMoves") {
+        defer_moves = value == "true";
+    } else if (name == "PawnHash") {
+        pawntt_megabytes = stoi(value);
+        allocate_thread_tables();
+        print_thread_memory();
+    } else if (name == "EvalHash") {
+        eval_cache_megabytes = stoi(value);
+        allocate_thread_tables();
+        print_thread_memory();
     } else if (name == "SyzygyPath") {
         init_syzygy(value);
     } else if (name == "MoveOverhead") {
@@ -221,7 +295,8 @@ void setoption() {
 }
 
 void ucinewgame() {
-    clear_tt();
+    int time_taken = clear_tt();
+    cout << "info string Hash cleared in " << time_taken << " ms using " << num_threads << " threads" << endl;
 }
 
 void run_command(string s) {
@@ -249,10 +324,24 @@ void run_command(string s) {
         generate();
     if (s == "stop")
         stop();
+    if (s == "ponderhit")
+        ponderhit();
     if (s == "see")
         see();
-    if (s == "bench")
-        bench();
+    if (s == "bench") {
+        if (word_equal(1, "smp")) {
+            smp_bench(word_list.size() > 2 ? stoi(word_list[2]) : 12);
+        } else if (word_equal(1, "sliders")) {
+            if (!slider_bench()) {
+                destroy_pool();
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            bench();
+        }
+    }
+    if (s == "tt")
+        cmd_tt();
 #ifdef __TUNE__
     if (s == "tune")
         tune();
@@ -262,6 +351,9 @@ void run_command(string s) {
 void loop() {
     string in_str;
     init();
+    init_pool();
+    // After the pool, whose workers first touch the hash
+    init_tt();
 #ifdef __TUNE__
     tune();
 #endif